@@ -0,0 +1,120 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include "../include/numarray.h"
+#include "../include/numeric.h"
+
+/*
+ * @brief Compares numeric loops over a vector of doubles with the same operations on an
+ * f64-array
+ *
+ * The vector side is what a script does without arrays: a reduce with + over the elements,
+ * or a new vector built from pairs of elements. Each operation runs over about 10M elements
+ * in total, whatever the size. Times are ns per element.
+ *
+ * Usage: bench_array [largest size]
+ * */
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    std::size_t max_size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+#if defined(__x86_64__)
+    std::cout << "kernels: " << (__builtin_cpu_supports("avx2") ? "avx2" : "sse2") << "\n";
+#endif
+    std::cout << std::left << std::setw(10) << "size" << std::setw(8) << "op" << std::right << std::setw(12) << "vector ns"
+              << std::setw(11) << "array ns" << std::setw(10) << "speedup" << "\n"
+              << std::fixed << std::setprecision(2);
+
+    for (std::size_t size = 1000; size <= max_size; size *= 10) {
+        auto rounds = std::max<std::size_t>(1, 10000000 / size);
+        auto report = [&](const char* op, double vector_time, double array_time) {
+            auto per_element = [&](double time) { return time * 1e9 / static_cast<double>(size * rounds); };
+
+            std::cout << std::left << std::setw(10) << size << std::setw(8) << op << std::right
+                      << std::setw(12) << per_element(vector_time) << std::setw(11) << per_element(array_time)
+                      << std::setw(9) << vector_time / array_time << "x\n";
+        };
+
+        auto vector = MalNode::Make<Vector>();
+        for (std::size_t index = 0; index < size; index++)
+            vector.As<Vector>()->Add(MalNode::Double(static_cast<double>(index % 1000) * 0.5));
+        auto array = MakeF64Array(vector);
+
+        MalNode vector_result, array_result;
+        auto vector_sum = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++) {
+                vector_result = MalNode::Int(0);
+                vector.As<Vector>()->ForEach([&](const MalNode& element) { vector_result = AddNumbers(vector_result, element); });
+            }
+        });
+        auto array_sum = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++)
+                array_result = ArrayReduce(ArrayReduceOp::Sum, array);
+        });
+        report("sum", vector_sum, array_sum);
+
+        if (vector_result.AsDouble() != array_result.AsDouble())
+            return 1;
+
+        auto vector_add = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++) {
+                vector_result = MalNode::Make<Vector>();
+                vector.As<Vector>()->ForEach([&](const MalNode& element) {
+                    vector_result.As<Vector>()->Add(AddNumbers(element, element));
+                });
+            }
+        });
+        auto array_add = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++)
+                array_result = ArrayArithmetic(ArrayOp::Add, array, array);
+        });
+        report("add", vector_add, array_add);
+
+        if (!(MakeF64Array(vector_result) == array_result))
+            return 1;
+
+        auto vector_dot = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++) {
+                vector_result = MalNode::Int(0);
+                vector.As<Vector>()->ForEach([&](const MalNode& element) {
+                    vector_result = AddNumbers(vector_result, MultiplyNumbers(element, element));
+                });
+            }
+        });
+        auto array_dot = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++)
+                array_result = ArrayDot(array, array);
+        });
+        report("dot", vector_dot, array_dot);
+
+        auto vector_max = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++) {
+                vector_result = vector.As<Vector>()->Nth(0);
+                vector.As<Vector>()->ForEach([&](const MalNode& element) {
+                    if (CompareNumbers(element, vector_result) > 0)
+                        vector_result = element;
+                });
+            }
+        });
+        auto array_max = TimeSeconds([&] {
+            for (std::size_t round = 0; round < rounds; round++)
+                array_result = ArrayReduce(ArrayReduceOp::Max, array);
+        });
+        report("max", vector_max, array_max);
+
+        if (!(vector_result == array_result))
+            return 1;
+    }
+
+    return 0;
+}
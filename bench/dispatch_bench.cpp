@@ -0,0 +1,117 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/types.h"
+
+/*
+ * @brief Measures dispatch on heap values: type tests, equality, hashing and printing
+ * over a mix of small values of every heap type
+ *
+ * Type tests are timed both as a tag compare and, when built with RTTI, as the
+ * dynamic_cast it replaced. The other operations dispatch on the type tag, build
+ * this file at an older commit to compare with virtual calls.
+ *
+ * Usage: bench_dispatch [millions of operations]
+ * */
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+/*
+ * @brief One small value of each heap type, built fresh so equal values are distinct objects
+ * */
+std::vector<MalNode> MakeValues(std::int64_t seed) {
+    auto list = MalNode::Make<List>();
+    list.As<List>()->Add(MalNode::Int(seed));
+    list.As<List>()->Add(MalNode::Int(seed + 1));
+
+    auto vector = MalNode::Make<Vector>();
+    vector.As<Vector>()->Add(MalNode::Int(seed));
+
+    auto hash_map = MalNode::Make<HashMap>();
+    hash_map.As<HashMap>()->Add(MalNode::Int(seed), MalNode::Nil());
+
+    return {
+        list, vector, hash_map,
+        MalNode::Make<String>("value " + std::to_string(seed)),
+        MalNode::Make<Quote>(MalNode::Int(seed)),
+        MalNode::Make<Quasiquote>(MalNode::Int(seed)),
+        MalNode::Make<Unquote>(MalNode::Int(seed)),
+        MalNode::Make<Builtin>("nil", 0, 0, [](std::vector<MalNode>&) { return MalNode::Nil(); })
+    };
+}
+
+int main(int argc, char** argv) {
+    std::size_t millions = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10;
+    auto operations = millions * 1000 * 1000;
+
+    std::vector<MalNode> values;
+    std::vector<MalNode> copies;
+    for (std::int64_t seed = 0; seed < 64; seed++) {
+        for (auto& value : MakeValues(seed))
+            values.push_back(value);
+        for (auto& value : MakeValues(seed))
+            copies.push_back(value);
+    }
+
+    // Whole passes over the values, so the loops index without a division
+    auto passes = operations / values.size();
+    operations = passes * values.size();
+
+    std::size_t sink = 0;
+    auto report = [&](const char* op, double seconds) {
+        std::cout << std::left << std::setw(16) << op << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << seconds * 1e9 / static_cast<double>(operations) << " ns/op\n";
+    };
+
+    report("tag test", TimeSeconds([&] {
+        for (std::size_t pass = 0; pass < passes; pass++)
+            for (std::size_t index = 0; index < values.size(); index++)
+                sink += values[index].Type() == MalType::NodeType::List;
+    }));
+
+#if defined(__GXX_RTTI)
+    report("dynamic_cast", TimeSeconds([&] {
+        for (std::size_t pass = 0; pass < passes; pass++)
+            for (std::size_t index = 0; index < values.size(); index++)
+                sink += dynamic_cast<List*>(values[index].Get()) != nullptr;
+    }));
+#endif
+
+    report("equal", TimeSeconds([&] {
+        for (std::size_t pass = 0; pass < passes; pass++)
+            for (std::size_t index = 0; index < values.size(); index++)
+                sink += values[index] == copies[index];
+    }));
+
+    report("hash", TimeSeconds([&] {
+        for (std::size_t pass = 0; pass < passes; pass++)
+            for (std::size_t index = 0; index < values.size(); index++)
+                sink += values[index].Hash();
+    }));
+
+    std::string out;
+    report("print", TimeSeconds([&] {
+        for (std::size_t pass = 0; pass < passes; pass++) {
+            for (std::size_t index = 0; index < values.size(); index++) {
+                out.clear();
+                values[index].PrintTo(out, true);
+                sink += out.size();
+            }
+        }
+    }));
+
+    // Keeps the loops from being optimized away
+    std::cout << "checksum " << sink << "\n";
+
+    return 0;
+}
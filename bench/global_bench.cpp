@@ -0,0 +1,76 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/compiler.h"
+#include "../include/core.h"
+#include "../include/environment.h"
+#include "../include/reader.h"
+#include "../include/vm.h"
+
+/*
+ * @brief Measures the cost of reading a global: a hash lookup in the global Environment,
+ * and a LoadGlobal through its cached var cell in compiled code
+ *
+ * Usage: bench_globals [millions of iterations]
+ * */
+
+MalNode Eval(const std::string& src, Environment& env) {
+    Reader reader {src};
+    reader.Tokenize();
+
+    return VM::Instance().Run(Compile(reader.ReadForm()), env);
+}
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    std::size_t millions = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 10;
+    auto iterations = static_cast<std::int64_t>(millions) * 1000 * 1000;
+
+    GcRef<Environment> env = MakeGc<Environment>();
+    Core core;
+    for (auto& [bind, expr] : core.GetEnv())
+        env->Set(bind, expr);
+
+    // A few hundred user globals, so the map is the size of a real program's
+    for (int index = 0; index < 500; index++)
+        env->Set("global-" + std::to_string(index), MalNode::Int(index));
+
+    std::vector<InternId> names {Intern("+"), Intern("-"), Intern("="), Intern("count"), Intern("global-42")};
+    std::int64_t found = 0;
+    auto lookup_time = TimeSeconds([&] {
+        for (std::int64_t index = 0; index < iterations; index++)
+            found += env->Get(names[static_cast<std::size_t>(index) % names.size()]).IsHeap();
+    });
+
+    // Two loops that differ only in sixteen extra reads per iteration, of a global or of a local
+    std::string globals, locals;
+    for (int index = 0; index < 16; index++) {
+        globals += " global-42";
+        locals += " n";
+    }
+
+    Eval("(def! global-loop (fn* (n) (if (= n 0) 0 (do" + globals + " (global-loop (- n 1))))))", *env);
+    Eval("(def! local-loop (fn* (n) (if (= n 0) 0 (do" + locals + " (local-loop (- n 1))))))", *env);
+
+    auto global_time = TimeSeconds([&] { Eval("(global-loop " + std::to_string(iterations) + ")", *env); });
+    auto local_time = TimeSeconds([&] { Eval("(local-loop " + std::to_string(iterations) + ")", *env); });
+
+    auto per = [](double seconds, double count) { return seconds * 1e9 / count; };
+    std::cout << "iterations:         " << iterations << " (" << found << " heap values)\n";
+    std::cout << "Environment::Get:   " << per(lookup_time, iterations) << " ns/lookup\n";
+    std::cout << "loop over globals:  " << per(global_time, iterations) << " ns/iteration\n";
+    std::cout << "loop over locals:   " << per(local_time, iterations) << " ns/iteration\n";
+    std::cout << "cached global load: " << per(global_time - local_time, 16.0 * iterations) << " ns more than a local\n";
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <regex>
+#include <string>
+#include <vector>
+
+#include "../include/reader.h"
+
+/*
+ * @brief Compares the hand-written Lexer with the std::regex tokenizer it replaced
+ *
+ * Usage: bench_lexer [megabytes]
+ * */
+
+static const std::string lisp_regex_str = "[\\s,]*(~@|[\\[\\]{}()'`~^@]|\"(?:\\\\.|[^\\\\\"])*\"?|;.*|[^\\s\\[\\]{}('\"`,;)]*)";
+
+static const std::string sample =
+    "(def! fib (fn* (n) ; naive fibonacci\n"
+    "  (if (< n 2) n (+ (fib (- n 1)) (fib (- n 2))))))\n"
+    "{:name \"rule-42\" :weight 1.5, :tags [\"a\" \"b\\\"c\"]}\n"
+    "`(a ~b ~@c 'd ^meta @deref -12 -x)\n";
+
+std::vector<std::string> RegexTokens(const std::string& src) {
+    std::vector<std::string> tokens;
+    std::regex lisp_regex {lisp_regex_str};
+
+    auto tokens_begin = std::sregex_iterator (src.begin(), src.end(), lisp_regex);
+    auto tokens_end = std::sregex_iterator ();
+
+    for (auto i = tokens_begin; i != tokens_end; i++) {
+        std::string match_str = (*i)[1].str();
+
+        if (match_str[0] == ';')
+            continue;
+
+        tokens.push_back(match_str);
+    }
+
+    // Trailing whitespace produces a second empty match, the Lexer reports End once
+    while (tokens.size() > 1 && tokens.back().empty() && tokens[tokens.size() - 2].empty())
+        tokens.pop_back();
+
+    return tokens;
+}
+
+std::vector<std::string_view> LexerTokens(std::string_view src) {
+    std::vector<std::string_view> tokens;
+    Lexer lexer {src};
+
+    while (true) {
+        auto token = lexer.Next();
+
+        if (token.kind_ == Token::Kind::Comment)
+            continue;
+
+        tokens.push_back(token.text_);
+
+        if (token.kind_ == Token::Kind::End)
+            break;
+    }
+
+    return tokens;
+}
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    std::size_t megabytes = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 4;
+
+    std::string src;
+    while (src.size() < megabytes * 1024 * 1024)
+        src += sample;
+
+    std::vector<std::string> regex_tokens;
+    std::vector<std::string_view> lexer_tokens;
+
+    auto regex_time = TimeSeconds([&] { regex_tokens = RegexTokens(src); });
+    auto lexer_time = TimeSeconds([&] { lexer_tokens = LexerTokens(src); });
+
+    bool same = regex_tokens.size() == lexer_tokens.size();
+    for (std::size_t index = 0; same && index < regex_tokens.size(); index++)
+        same = regex_tokens[index] == lexer_tokens[index];
+
+    auto mb = static_cast<double>(src.size()) / (1024 * 1024);
+    std::cout << "input:  " << mb << " MB, " << lexer_tokens.size() << " tokens\n";
+    std::cout << "regex:  " << regex_time << " s (" << mb / regex_time << " MB/s)\n";
+    std::cout << "lexer:  " << lexer_time << " s (" << mb / lexer_time << " MB/s)\n";
+    std::cout << "speedup: " << regex_time / lexer_time << "x\n";
+    std::cout << "tokens match: " << (same ? "yes" : "NO") << "\n";
+
+    return same ? 0 : 1;
+}
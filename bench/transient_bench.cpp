@@ -0,0 +1,96 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "../include/types.h"
+
+/*
+ * @brief Compares building a collection with repeated persistent updates, with a transient,
+ * and with the std container it would be read into by hand
+ *
+ * Each build adds size elements one at a time: conj/assoc keep only the latest version,
+ * as a loop over a data file would, the transient is updated in place and made persistent
+ * at the end. Times are ns per element.
+ *
+ * Usage: bench_transient [largest size]
+ * */
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+struct NodeHash {
+    std::size_t operator()(const MalNode& node) const { return node.Hash(); }
+};
+
+int main(int argc, char** argv) {
+    std::size_t max_size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::cout << std::left << std::setw(10) << "size" << std::setw(8) << "type" << std::right << std::setw(16) << "persistent ns"
+              << std::setw(15) << "transient ns" << std::setw(9) << "std ns" << std::setw(10) << "speedup" << "\n"
+              << std::fixed << std::setprecision(1);
+
+    for (std::size_t size = 10000; size <= max_size; size *= 10) {
+        auto report = [&](const char* type, double persistent_time, double transient_time, double std_time) {
+            auto per_element = [&](double time) { return time * 1e9 / static_cast<double>(size); };
+
+            std::cout << std::left << std::setw(10) << size << std::setw(8) << type << std::right
+                      << std::setw(16) << per_element(persistent_time) << std::setw(15) << per_element(transient_time)
+                      << std::setw(9) << per_element(std_time)
+                      << std::setw(9) << persistent_time / transient_time << "x\n";
+        };
+
+        MalNode persistent_vector, transient_vector;
+        auto vector_persistent = TimeSeconds([&] {
+            persistent_vector = MalNode::Make<Vector>();
+            for (std::size_t index = 0; index < size; index++)
+                persistent_vector = persistent_vector.As<Vector>()->Conj(MalNode::Int(static_cast<std::int64_t>(index)));
+        });
+        auto vector_transient = TimeSeconds([&] {
+            transient_vector = MalNode::Make<Vector>().As<Vector>()->Transient();
+            for (std::size_t index = 0; index < size; index++)
+                transient_vector.As<Vector>()->Add(MalNode::Int(static_cast<std::int64_t>(index)));
+            transient_vector.As<Vector>()->Persist();
+        });
+        std::vector<MalNode> std_vector;
+        auto vector_std = TimeSeconds([&] {
+            for (std::size_t index = 0; index < size; index++)
+                std_vector.push_back(MalNode::Int(static_cast<std::int64_t>(index)));
+        });
+        report("vector", vector_persistent, vector_transient, vector_std);
+
+        if (!(persistent_vector == transient_vector))
+            return 1;
+
+        MalNode persistent_map, transient_map;
+        auto map_persistent = TimeSeconds([&] {
+            persistent_map = MalNode::Make<HashMap>();
+            for (std::size_t index = 0; index < size; index++)
+                persistent_map = persistent_map.As<HashMap>()->Assoc(MalNode::Int(static_cast<std::int64_t>(index)), MalNode::Int(1));
+        });
+        auto map_transient = TimeSeconds([&] {
+            transient_map = MalNode::Make<HashMap>().As<HashMap>()->Transient();
+            for (std::size_t index = 0; index < size; index++)
+                transient_map.As<HashMap>()->Add(MalNode::Int(static_cast<std::int64_t>(index)), MalNode::Int(1));
+            transient_map.As<HashMap>()->Persist();
+        });
+        std::unordered_map<MalNode, MalNode, NodeHash> std_map;
+        auto map_std = TimeSeconds([&] {
+            for (std::size_t index = 0; index < size; index++)
+                std_map.emplace(MalNode::Int(static_cast<std::int64_t>(index)), MalNode::Int(1));
+        });
+        report("map", map_persistent, map_transient, map_std);
+
+        if (!(persistent_map == transient_map))
+            return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../include/types.h"
+
+/*
+ * @brief Compares the persistent Vector with the copy-on-update std::vector it replaced
+ *
+ * For each size, times functional updates (conj, assoc) and reads (nth). A copy-on-update
+ * vector copies every element per update, so each update is timed on its own, as ns/op.
+ *
+ * Usage: bench_vector [updates per size]
+ * */
+
+template<typename F>
+double TimeSeconds(F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    f();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - start).count();
+}
+
+int main(int argc, char** argv) {
+    std::size_t updates = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    std::mt19937 rng {42};
+
+    std::cout << std::left << std::setw(10) << "size" << std::setw(8) << "op" << std::right << std::setw(14) << "copy ns/op"
+              << std::setw(18) << "persistent ns/op" << std::setw(10) << "speedup" << "\n" << std::fixed << std::setprecision(1);
+
+    for (std::size_t size = 1000; size <= 1000000; size *= 10) {
+        auto persistent = MalNode::Make<Vector>();
+        std::vector<MalNode> copied;
+        for (std::size_t index = 0; index < size; index++) {
+            persistent.As<Vector>()->Add(MalNode::Int(static_cast<std::int64_t>(index)));
+            copied.push_back(MalNode::Int(static_cast<std::int64_t>(index)));
+        }
+
+        std::vector<std::size_t> indices(updates);
+        for (auto& index : indices)
+            index = rng() % size;
+
+        // Only the latest result is kept: keeping every copy of a 1M element vector would
+        // take gigabytes. Each update frees the previous copy, as a loop over versions would.
+        MalNode persistent_result;
+        std::vector<MalNode> copied_result;
+
+        auto report = [&](const char* op, double copy_time, double persistent_time) {
+            std::cout << std::left << std::setw(10) << size << std::setw(8) << op << std::right
+                      << std::setw(14) << copy_time * 1e9 / static_cast<double>(updates)
+                      << std::setw(18) << persistent_time * 1e9 / static_cast<double>(updates)
+                      << std::setw(9) << copy_time / persistent_time << "x\n";
+            persistent_result = MalNode{};
+            copied_result.clear();
+        };
+
+        auto copy_conj = TimeSeconds([&] {
+            for (std::size_t index = 0; index < updates; index++) {
+                std::vector<MalNode> next(copied.size() + 1);
+                std::copy(copied.begin(), copied.end(), next.begin());
+                next.back() = MalNode::Int(1);
+                copied_result.swap(next);
+            }
+        });
+        auto persistent_conj = TimeSeconds([&] {
+            for (std::size_t index = 0; index < updates; index++)
+                persistent_result = persistent.As<Vector>()->Conj(MalNode::Int(1));
+        });
+        report("conj", copy_conj, persistent_conj);
+
+        auto copy_assoc = TimeSeconds([&] {
+            for (auto index : indices) {
+                auto next = copied;
+                next[index] = MalNode::Int(-1);
+                copied_result.swap(next);
+            }
+        });
+        auto persistent_assoc = TimeSeconds([&] {
+            for (auto index : indices)
+                persistent_result = persistent.As<Vector>()->Assoc(index, MalNode::Int(-1));
+        });
+        report("assoc", copy_assoc, persistent_assoc);
+
+        std::int64_t sum = 0;
+        auto copy_nth = TimeSeconds([&] {
+            for (auto index : indices)
+                sum += copied[index].AsInt();
+        });
+        auto persistent_nth = TimeSeconds([&] {
+            for (auto index : indices)
+                sum -= persistent.As<Vector>()->Nth(index).AsInt();
+        });
+        report("nth", copy_nth, persistent_nth);
+
+        if (sum != 0)
+            return 1;
+    }
+
+    return 0;
+}
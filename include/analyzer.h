@@ -0,0 +1,159 @@
+#ifndef MAL_ANALYZER_H
+#define MAL_ANALYZER_H
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+
+class Compiler;
+
+/*
+ * @brief What analysis learned about the bindings of one function body (or of a top-level form)
+ *
+ * defines_ collects the names def! binds in the innermost let* or function body, so the
+ * Compiler can give them slots up front.
+ * */
+struct Scope {
+    std::vector<InternId>* defines_ = nullptr;
+};
+
+/*
+ * @brief A form that has been analyzed once: special forms decided, symbols interned
+ * and constants hoisted. The Compiler turns it into bytecode.
+ * */
+class Code {
+public:
+    virtual ~Code() {}
+
+    /*
+     * @brief Emits the bytecode that leaves this form's value on the stack
+     *
+     * @param Compiler and whether the form is in tail position
+     * */
+    virtual void Compile(Compiler& compiler, bool tail) const = 0;
+};
+
+using CodePtr = std::shared_ptr<const Code>;
+
+/*
+ * @brief Self-evaluating values, and hoisted literals with no symbols in them
+ * */
+class Constant : public Code {
+public:
+    explicit Constant(MalNode value) : value_{std::move(value)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    MalNode value_;
+};
+
+class Lookup : public Code {
+public:
+    explicit Lookup(InternId symbol) : symbol_{symbol} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    InternId symbol_;
+};
+
+class Define : public Code {
+public:
+    Define(InternId symbol, CodePtr value) : symbol_{symbol}, value_{std::move(value)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    InternId symbol_;
+    CodePtr value_;
+};
+
+class Let : public Code {
+public:
+    Let(std::vector<std::pair<InternId, CodePtr>> bindings, CodePtr body, std::vector<InternId> defines) :
+        bindings_{std::move(bindings)}, body_{std::move(body)}, defines_{std::move(defines)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    std::vector<std::pair<InternId, CodePtr>> bindings_;
+    CodePtr body_;
+    std::vector<InternId> defines_;
+};
+
+class Do : public Code {
+public:
+    explicit Do(std::vector<CodePtr> forms) : forms_{std::move(forms)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    std::vector<CodePtr> forms_;
+};
+
+class If : public Code {
+public:
+    If(CodePtr condition, CodePtr then, CodePtr otherwise) :
+        condition_{std::move(condition)}, then_{std::move(then)}, otherwise_{std::move(otherwise)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    CodePtr condition_;
+    CodePtr then_;
+    CodePtr otherwise_;
+};
+
+/*
+ * @brief fn*, whose body is analyzed once and compiled into its own Chunk
+ *
+ * source_ is the body form itself, which closures carry alongside the compiled body.
+ * */
+class Lambda : public Code {
+public:
+    Lambda(std::vector<InternId> binds, CodePtr body, std::vector<InternId> defines, MalNode source) :
+        binds_{std::move(binds)}, body_{std::move(body)}, defines_{std::move(defines)}, source_{std::move(source)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    std::vector<InternId> binds_;
+    CodePtr body_;
+    std::vector<InternId> defines_;
+    MalNode source_;
+};
+
+class Call : public Code {
+public:
+    Call(CodePtr callee, std::vector<CodePtr> args) : callee_{std::move(callee)}, args_{std::move(args)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    CodePtr callee_;
+    std::vector<CodePtr> args_;
+};
+
+class VectorLiteral : public Code {
+public:
+    explicit VectorLiteral(std::vector<CodePtr> elements) : elements_{std::move(elements)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    std::vector<CodePtr> elements_;
+};
+
+class HashMapLiteral : public Code {
+public:
+    explicit HashMapLiteral(std::vector<std::pair<CodePtr, CodePtr>> entries) : entries_{std::move(entries)} {}
+    void Compile(Compiler& compiler, bool tail) const override;
+
+private:
+    std::vector<std::pair<CodePtr, CodePtr>> entries_;
+};
+
+/*
+ * @brief Walks a form once and builds the Code tree for it
+ *
+ * @param AST and the Scope of the enclosing function body
+ * @return Analyzed tree
+ * */
+CodePtr Analyze(const MalNode& form, Scope& scope);
+
+#endif // MAL_ANALYZER_H
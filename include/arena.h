@@ -0,0 +1,88 @@
+#ifndef MAL_ARENA_H
+#define MAL_ARENA_H
+
+#include <array>
+#include <cstddef>
+#include <new>
+#include <vector>
+
+/*
+ * @brief Size-class pool that heap values and environments are allocated from
+ *
+ * Small objects are carved out of 64 KiB blocks with a bump pointer. A freed object goes
+ * on the free list of its 16-byte size class and is handed out again by the next
+ * allocation of that size, so a steady-state workload recycles the same memory instead
+ * of calling malloc and free for every value. Trim returns the blocks whose objects are
+ * all free to the system, the REPL calls it between evaluations. Larger objects go to
+ * operator new.
+ * */
+class Arena {
+public:
+    static constexpr std::size_t block_size = 64 * 1024;
+    static constexpr std::size_t granule = 16;
+    static constexpr std::size_t max_small = 256;
+
+    static Arena& Instance();
+
+    void* Allocate(std::size_t size) {
+        if (size > max_small)
+            return ::operator new(size);
+
+        auto& head = free_lists_[SizeClass(size)];
+        if (head != nullptr) {
+            auto block = head;
+            head = head->next_;
+            return block;
+        }
+
+        auto rounded = (SizeClass(size) + 1) * granule;
+        if (static_cast<std::size_t>(end_ - cursor_) < rounded)
+            NewBlock();
+
+        auto block = cursor_;
+        cursor_ += rounded;
+        return block;
+    }
+
+    void Free(void* ptr, std::size_t size) {
+        if (size > max_small) {
+            ::operator delete(ptr);
+            return;
+        }
+
+        auto& head = free_lists_[SizeClass(size)];
+        head = new (ptr) FreeBlock{head};
+    }
+
+    /*
+     * @brief Bytes reserved from the system for small objects
+     * */
+    std::size_t Reserved() const { return blocks_.size() * block_size; }
+
+    /*
+     * @brief Returns every block with no live object in it to the system
+     *
+     * Walks all the free lists, so it is meant for the gaps between evaluations rather
+     * than for the allocation path.
+     * */
+    void Trim();
+
+private:
+    Arena();
+
+    struct FreeBlock {
+        FreeBlock* next_;
+    };
+
+    static std::size_t SizeClass(std::size_t size) { return (size - 1) / granule; }
+
+    void NewBlock();
+
+private:
+    std::array<FreeBlock*, max_small / granule> free_lists_;
+    char* cursor_;
+    char* end_;
+    std::vector<char*> blocks_;
+};
+
+#endif // MAL_ARENA_H
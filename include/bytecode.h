@@ -0,0 +1,100 @@
+#ifndef MAL_BYTECODE_H
+#define MAL_BYTECODE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+/*
+ * @brief VM instructions. Operands follow the opcode as little-endian uint16s.
+ * */
+enum class OpCode : std::uint8_t {
+    Constant,       // k        push constants_[k]
+    Nil,            //          push nil
+    True,           //          push true
+    False,          //          push false
+    Pop,            //          drop the top of the stack
+    LoadLocal,      // s        push slot s of the frame
+    StoreLocal,     // s        pop into slot s of the frame
+    LoadBoxed,      // s        push slot s of the frame, or what it holds once a closure boxed it
+    StoreBoxed,     // s        pop into slot s of the frame, or into its box
+    LoadCapture,    // c        push capture c of the running closure
+    LoadCaptureBoxed, // c      push what the box in capture c of the running closure holds
+    LoadGlobal,     // g        push the global of globals_[g], through its cached cell
+    DefineGlobal,   // g        bind the global of globals_[g] to the top of the stack, leaving it there
+    Jump,           // o        skip forward o bytes
+    JumpIfFalse,    // o        pop, and skip forward o bytes if nil or false
+    Call,           // n        call the function below the top n values with them as arguments
+    TailCall,       // n        as Call, replacing the current frame
+    Return,         //          pop the result and return it to the caller
+    Closure,        // f        push a closure over functions_[f], copying the captures it lists
+    MakeVector,     // n        pop n values into a new vector
+    MakeHashMap,    // n        pop n key/value pairs into a new hash map
+    Count
+};
+
+/*
+ * @brief Inline cache of a global: the var cell of symbol_ in the globals whose Id is env_id_
+ *
+ * Filled by the first LoadGlobal to run, so later loads are one compare and one pointer load.
+ * */
+struct GlobalSite {
+    InternId symbol_;
+    std::uint64_t env_id_ = 0;
+    MalNode* cell_ = nullptr;
+};
+
+/*
+ * @brief A variable of an enclosing function that a closure copies when it is made
+ *
+ * It comes from slot index_ of the frame making the closure when local_ is set, and from
+ * capture index_ of the closure running in that frame otherwise. A boxed capture is
+ * shared with the frame through a Box, as the binding can still change.
+ * */
+struct Capture {
+    InternId symbol_;
+    std::uint16_t index_;
+    bool local_;
+    bool boxed_;
+};
+
+/*
+ * @brief The compiled body of a function, or of a top-level form
+ *
+ * Slots 0..arity_-1 hold the parameters (then the rest list for a variadic function),
+ * the remaining slots up to locals_ hold let* and local def! bindings, and max_stack_
+ * operand slots follow them. A closure over a function carries a copy of each of its
+ * captures_, the free variables its body refers to, and the binds_ and body_ of the
+ * fn* it was compiled from.
+ * */
+struct Chunk {
+    std::string name_;
+    std::vector<std::uint8_t> code_;
+    std::vector<MalNode> constants_;
+    std::vector<std::shared_ptr<const Chunk>> functions_;
+    std::vector<Capture> captures_;
+    std::vector<InternId> binds_;
+    MalNode body_;
+    mutable std::vector<GlobalSite> globals_;
+    std::uint16_t arity_ = 0;
+    std::uint16_t locals_ = 0;
+    std::uint16_t max_stack_ = 0;
+    bool variadic_ = false;
+};
+
+/*
+ * @brief Number of uint16 operands that follow each opcode
+ * */
+int OperandCount(OpCode op);
+
+const char* OpName(OpCode op);
+
+/*
+ * @brief Human-readable listing of a chunk and of the functions nested in it
+ * */
+std::string Disassemble(const Chunk& chunk);
+
+#endif // MAL_BYTECODE_H
@@ -0,0 +1,133 @@
+#ifndef MAL_COMPILER_H
+#define MAL_COMPILER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "analyzer.h"
+#include "bytecode.h"
+
+/*
+ * @brief Emits the bytecode for one function body, or for a top-level form
+ *
+ * Code nodes drive the Compiler through Emit and the binding helpers. Variables are
+ * resolved here, once: to a slot of the VM frame, to a capture of the running closure,
+ * or to a global. A variable of an enclosing function becomes a capture of each function
+ * between it and the reference, so closures only copy the free variables they use. The
+ * Compiler also tracks the operand stack depth so the VM can size frames up front.
+ * */
+class Compiler {
+public:
+    /*
+     * @brief Where a variable lives at run time
+     * */
+    struct Location {
+        enum class Kind { Local, Capture, Global };
+
+        Kind kind_;
+        std::uint16_t slot_;    // frame slot or capture index
+        InternId symbol_;
+        bool boxed_;
+    };
+
+    explicit Compiler(std::string name, Compiler* enclosing = nullptr);
+
+    void Emit(OpCode op);
+    void Emit(OpCode op, std::uint16_t operand);
+
+    /*
+     * @brief Emits a forward jump whose offset is filled in by PatchJump
+     *
+     * @return Position of the offset to patch
+     * */
+    std::size_t EmitJump(OpCode op);
+    void PatchJump(std::size_t at);
+
+    std::uint16_t AddConstant(MalNode value);
+    std::uint16_t AddFunction(std::shared_ptr<const Chunk> function);
+
+    /*
+     * @brief Index of the GlobalSite of symbol, shared by every reference to it in this chunk
+     * */
+    std::uint16_t AddGlobal(InternId symbol);
+
+    void BeginBlock();
+    void EndBlock();
+
+    /*
+     * @brief The binding of symbol in the innermost block, declaring a pending one if there is none
+     *
+     * A pending binding is not seen by the code of this function until Settle, but closures
+     * see it, as they only look it up once called. Blocks declare all their names up front,
+     * so closures bound early in a let* can call ones bound later. rebound is set for def!,
+     * which can bind the name again.
+     * */
+    Location Declare(InternId symbol, bool rebound = false);
+    void Settle(InternId symbol);
+
+    Location Resolve(InternId symbol);
+    void EmitLoad(const Location& location);
+    void EmitStore(const Location& location);
+    bool InLocalScope() const { return !blocks_.empty(); }
+
+    /*
+     * @brief Declares the parameters, binding '&' rest parameters as a variadic list
+     *
+     * The parameters and the body form are kept on the chunk for the closures made from it.
+     * */
+    void DeclareParams(const std::vector<InternId>& binds, const MalNode& body);
+
+    int Depth() const { return depth_; }
+    void SetDepth(int depth) { depth_ = depth; }
+
+    /*
+     * @brief Name given to the next fn* compiled, so def! names show in disassembly
+     * */
+    std::string TakeFunctionName();
+    void SetFunctionName(std::string name) { function_name_ = std::move(name); }
+
+    std::shared_ptr<const Chunk> Finish();
+
+private:
+    struct Binding {
+        InternId symbol_;
+        std::uint16_t slot_;
+        bool pending_;
+        bool rebound_;
+        bool boxed_;    // captured by a closure while it could still change
+    };
+
+    struct Block {
+        std::vector<Binding> bindings_;
+    };
+
+    void Adjust(int delta);
+    Binding* FindBinding(InternId symbol, bool pending);
+
+    /*
+     * @brief symbol as a capture of this function, added on first use, or as a global
+     * */
+    Location ResolveCapture(InternId symbol);
+
+private:
+    std::shared_ptr<Chunk> chunk_;
+    Compiler* enclosing_;
+    std::vector<Block> blocks_;
+    std::uint16_t next_slot_;
+    int depth_;
+    int max_depth_;
+    std::string function_name_;
+};
+
+/*
+ * @brief Analyzes and compiles a top-level form
+ *
+ * @param AST
+ * @return Chunk that evaluates the form when run by the VM
+ * */
+std::shared_ptr<const Chunk> Compile(const MalNode& form);
+
+#endif // MAL_COMPILER_H
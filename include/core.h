@@ -5,15 +5,16 @@
 #include <memory>
 #include <ranges>
 
+#include "bytecode.h"
 #include "types.h"
 
 struct Core {
 public:
     Core();
-    const std::unordered_map<std::string, MalNode>& GetEnv() const;
+    const std::unordered_map<InternId, MalNode>& GetEnv() const;
 
 private:
-    std::unordered_map<std::string, MalNode> core_env_;
+    std::unordered_map<InternId, MalNode> core_env_;
 };
 
 #endif // MAL_CORE_H
\ No newline at end of file
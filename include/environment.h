@@ -5,24 +5,72 @@
 #ifndef MAL_ENVIRONMENT_H
 #define MAL_ENVIRONMENT_H
 
+#include <cassert>
+#include <cstdint>
 #include <functional>
 #include <ranges>
 #include <unordered_map>
 #include <vector>
 
+#include "gc.h"
 #include "types.h"
 
-class Environment {
+/*
+ * @brief A scope of bindings, owned by the collector and created with MakeGc
+ *
+ * The global scope and the tree-walking steps bind by name in map_. Compiled code
+ * only uses the global scope, its local variables live in VM frames and closures.
+ *
+ * Each value in map_ is the var cell of its name: map nodes never move, and Set on a
+ * bound name assigns in place, so compiled code can keep a pointer to the cell.
+ * */
+class Environment : public GcObject {
 public:
     Environment();
-    Environment(Environment* outer);
-    Environment(Environment* outer, const std::vector<std::string>& bind, const std::vector<MalNode>& exprs);
+    Environment(GcRef<Environment> outer, bool tracked = true);
+    Environment(GcRef<Environment> outer, const std::vector<InternId>& bind, const std::vector<MalNode>& exprs,
+        bool tracked = true);
 
-    void Set(std::string symbol, MalNode data);
-    MalNode Get(std::string key);
+    void Set(InternId symbol, MalNode data);
+    void Set(std::string_view symbol, MalNode data);
+    MalNode Get(InternId key);
+
+    /*
+     * @brief The var cell bound to key here or in an outer scope
+     *
+     * @return Cell, valid while this Environment lives, or nullptr if key is unbound
+     * */
+    MalNode* Find(InternId key);
+
+    /*
+     * @brief Unique over the life of the process, so caches can tell environments apart
+     * */
+    std::uint64_t Id() const { return id_; }
+    GcRef<Environment> Outer() const { return outer_; }
+
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
 private:
-    std::unordered_map<std::string, MalNode> map_;
-    Environment* outer_;
+    std::unordered_map<InternId, MalNode> map_;
+    GcRef<Environment> outer_;
+    std::uint64_t id_;
+};
+
+/*
+ * @brief A frame on the C++ stack, for a scope no closure can capture
+ *
+ * The tree-walking steps use it when escape analysis shows the scope's forms contain no
+ * fn*, so nothing refers to the frame once they return. It is untracked, so the collector
+ * sees what it binds as held from outside the heap, like a MalNode on the stack. Its own
+ * reference keeps the scopes nested in it from freeing it.
+ * */
+class StackEnvironment : public Environment {
+public:
+    template<typename... Args>
+    explicit StackEnvironment(Args&&... args) : Environment(std::forward<Args>(args)..., false) { refcount_ = 1; }
+    ~StackEnvironment() override { assert(refcount_ == 1); }
+
+    static void* operator new(std::size_t size) = delete;
 };
 
 #endif //MAL_ENVIRONMENT_H
@@ -0,0 +1,173 @@
+#ifndef MAL_GC_H
+#define MAL_GC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "arena.h"
+
+struct GcObject;
+
+/*
+ * @brief Callback handed to GcObject::Trace, called once per outgoing reference
+ * */
+struct GcVisitor {
+    virtual ~GcVisitor() {}
+    virtual void Visit(GcObject* object) = 0;
+};
+
+/*
+ * @brief Base of every heap object owned by the collector
+ *
+ * Objects are reference counted, which frees acyclic garbage immediately. Objects
+ * that can hold references (collections, closures, environments) are also tracked
+ * by the collector, which periodically finds and frees unreachable cycles.
+ *
+ * Their memory comes from the Arena, unless built with MAL_NO_ARENA (e.g. for sanitizers).
+ * */
+struct GcObject {
+    explicit GcObject(bool tracked);
+    GcObject(const GcObject&) = delete;
+    GcObject& operator=(const GcObject&) = delete;
+    virtual ~GcObject();
+
+    static void* operator new(std::size_t size);
+    static void operator delete(void* ptr, std::size_t size);
+
+    /*
+     * @brief Visits every GcObject this object holds a counted reference to
+     * */
+    virtual void Trace([[maybe_unused]] GcVisitor& visitor) {}
+
+    /*
+     * @brief Drops every reference this object holds, used to break garbage cycles
+     * */
+    virtual void Clear() {}
+
+    void Retain() { refcount_++; }
+    void Release() {
+        if (--refcount_ == 0)
+            delete this;
+    }
+
+    bool IsTracked() const { return tracked_; }
+
+    std::uint32_t refcount_;
+
+private:
+    friend class Gc;
+
+    bool tracked_;
+    bool marked_;
+    std::int64_t gc_refs_;
+    GcObject* gc_prev_;
+    GcObject* gc_next_;
+};
+
+/*
+ * @brief Counted handle to a GcObject that is not a MAL value (e.g. Environment)
+ * */
+template<typename T>
+class GcRef {
+public:
+    GcRef() : ptr_{nullptr} {}
+    GcRef(T* ptr) : ptr_{ptr} { Retain(); }
+    GcRef(const GcRef& other) : ptr_{other.ptr_} { Retain(); }
+    GcRef(GcRef&& other) noexcept : ptr_{other.ptr_} { other.ptr_ = nullptr; }
+    ~GcRef() { Release(); }
+
+    GcRef& operator=(GcRef other) {
+        std::swap(ptr_, other.ptr_);
+        return *this;
+    }
+
+    T* get() const { return ptr_; }
+    T* operator->() const { return ptr_; }
+    T& operator*() const { return *ptr_; }
+    explicit operator bool() const { return ptr_ != nullptr; }
+
+    void reset() { GcRef{}.swap(*this); }
+    void swap(GcRef& other) { std::swap(ptr_, other.ptr_); }
+
+private:
+    void Retain() {
+        if (ptr_ != nullptr)
+            static_cast<GcObject*>(ptr_)->Retain();
+    }
+
+    void Release() {
+        if (ptr_ != nullptr)
+            static_cast<GcObject*>(ptr_)->Release();
+    }
+
+private:
+    T* ptr_;
+};
+
+struct GcStats {
+    std::size_t collections;
+    std::size_t tracked;
+    std::size_t collected;
+    std::size_t threshold;
+    std::size_t allocated;      // heap objects ever created, tracked or not, i.e. not on the stack
+    std::size_t live;
+};
+
+/*
+ * @brief Tracing collector for reference cycles among tracked objects
+ *
+ * Roots are found rather than registered: a tracked object whose reference count
+ * exceeds the references it receives from other tracked objects is held from
+ * outside the heap graph, i.e. by the REPL environment handle or by a MalNode or
+ * GcRef on the C++ stack. Everything reachable from a root is kept, the rest is
+ * cleared and freed.
+ *
+ * A collection runs before allocating a tracked object once the tracked count
+ * passes the threshold. The threshold then becomes
+ * max(min_threshold, survivors * growth_factor). Both can be set through the
+ * MAL_GC_MIN_THRESHOLD and MAL_GC_GROWTH_FACTOR environment variables.
+ * */
+class Gc {
+public:
+    static Gc& Instance();
+
+    void MaybeCollect() {
+        if (tracked_ >= threshold_)
+            Collect();
+    }
+
+    std::size_t Collect();
+    void SetThresholds(std::size_t min_threshold, double growth_factor);
+    GcStats Stats() const;
+
+private:
+    Gc();
+
+    void Track(GcObject* object);
+    void Untrack(GcObject* object);
+
+private:
+    friend struct GcObject;
+
+    GcObject* head_;
+    std::size_t tracked_;
+    std::size_t threshold_;
+    std::size_t min_threshold_;
+    double growth_factor_;
+    std::size_t collections_;
+    std::size_t collected_;
+    std::size_t allocated_;
+    std::size_t freed_;
+};
+
+/*
+ * @brief Allocates a non-value GcObject, collecting first if the heap has grown enough
+ * */
+template<typename T, typename... Args>
+GcRef<T> MakeGc(Args&&... args) {
+    Gc::Instance().MaybeCollect();
+    return GcRef<T>{new T(std::forward<Args>(args)...)};
+}
+
+#endif // MAL_GC_H
@@ -0,0 +1,57 @@
+#ifndef MAL_INTERN_H
+#define MAL_INTERN_H
+
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+using InternId = std::uint32_t;
+
+/*
+ * @brief Names the evaluator dispatches on, interned first so their ids are constants
+ * */
+struct SpecialForm {
+    enum : InternId {
+        Def,
+        Let,
+        Do,
+        If,
+        Fn,
+        Variadic,   // '&' in a parameter list
+        LazySeq
+    };
+};
+
+/*
+ * @brief Process-wide, thread-safe table mapping symbol/keyword names to dense ids
+ *
+ * Names are never removed, so an id and the canonical string it names stay
+ * valid for the lifetime of the process.
+ * */
+class InternTable {
+public:
+    static InternTable& Instance();
+
+    InternId Intern(std::string_view name);
+    const std::string& Name(InternId id) const;
+
+private:
+    InternTable();
+
+private:
+    mutable std::shared_mutex mutex_;
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, InternId> ids_;
+};
+
+/*
+ * @brief Shorthand for InternTable::Instance().Intern(name)
+ * */
+inline InternId Intern(std::string_view name) {
+    return InternTable::Instance().Intern(name);
+}
+
+#endif // MAL_INTERN_H
@@ -0,0 +1,60 @@
+#ifndef MAL_NUMARRAY_H
+#define MAL_NUMARRAY_H
+
+#include "types.h"
+
+/*
+ * @brief Operations over f64-arrays and i64-arrays
+ *
+ * The loops run as kernels built twice, for AVX2 and for the baseline (SSE2 on x86-64,
+ * plain scalar code elsewhere), and the loader picks the AVX2 build when the CPU has it.
+ * Either operand of an elementwise operation can be a number, which applies to every
+ * element. An f64 operand makes the result an f64-array. An i64 result that does not fit
+ * in 64 bits throws, as an array has no room for a BigInt, while sum and dot, whose
+ * result is a single number, give a BigInt like scalar arithmetic does.
+ * */
+enum class ArrayOp : std::uint8_t {
+    Add,
+    Subtract,
+    Multiply,
+    Divide
+};
+
+enum class ArrayCompareOp : std::uint8_t {
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Equal
+};
+
+enum class ArrayReduceOp : std::uint8_t {
+    Sum,
+    Min,
+    Max
+};
+
+inline bool IsArray(const MalNode& node) {
+    return node.Type() == MalType::NodeType::F64Array || node.Type() == MalType::NodeType::I64Array;
+}
+
+/*
+ * @brief The f64-array or i64-array of the numbers in a seq, of another array, or of n zeros
+ * */
+MalNode MakeF64Array(const MalNode& source);
+MalNode MakeI64Array(const MalNode& source);
+
+MalNode ArrayToVector(const MalNode& array);
+MalNode ArrayNth(const MalNode& array, std::size_t index);
+
+MalNode ArrayArithmetic(ArrayOp op, const MalNode& a, const MalNode& b);
+
+/*
+ * @brief i64-array of 1 where the comparison holds and 0 where it does not
+ * */
+MalNode ArrayCompare(ArrayCompareOp op, const MalNode& a, const MalNode& b);
+
+MalNode ArrayReduce(ArrayReduceOp op, const MalNode& array);
+MalNode ArrayDot(const MalNode& a, const MalNode& b);
+
+#endif // MAL_NUMARRAY_H
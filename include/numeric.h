@@ -0,0 +1,71 @@
+#ifndef MAL_NUMERIC_H
+#define MAL_NUMERIC_H
+
+#include <cstdint>
+#include <string_view>
+
+#include "types.h"
+
+/*
+ * @brief Arithmetic over the numeric tower
+ *
+ * Two integers give an exact integer: an Int while the result fits in 64 bits, checked
+ * with the overflow builtins, and a BigInt past that. A Double on either side makes the
+ * result a Double. The Int + Int case is inline, everything else goes to the *Slow
+ * functions. Integer division truncates toward zero. An f64-array or i64-array on either
+ * side makes the operation elementwise, see numarray.h.
+ * */
+MalNode AddSlow(const MalNode& a, const MalNode& b);
+MalNode SubtractSlow(const MalNode& a, const MalNode& b);
+MalNode MultiplySlow(const MalNode& a, const MalNode& b);
+MalNode DivideSlow(const MalNode& a, const MalNode& b);
+int CompareSlow(const MalNode& a, const MalNode& b);
+
+inline MalNode AddNumbers(const MalNode& a, const MalNode& b) {
+    std::int64_t result;
+    if (a.Type() == MalType::NodeType::Int && b.Type() == MalType::NodeType::Int && !__builtin_add_overflow(a.AsInt(), b.AsInt(), &result))
+        return MalNode::Int(result);
+
+    return AddSlow(a, b);
+}
+
+inline MalNode SubtractNumbers(const MalNode& a, const MalNode& b) {
+    std::int64_t result;
+    if (a.Type() == MalType::NodeType::Int && b.Type() == MalType::NodeType::Int && !__builtin_sub_overflow(a.AsInt(), b.AsInt(), &result))
+        return MalNode::Int(result);
+
+    return SubtractSlow(a, b);
+}
+
+inline MalNode MultiplyNumbers(const MalNode& a, const MalNode& b) {
+    std::int64_t result;
+    if (a.Type() == MalType::NodeType::Int && b.Type() == MalType::NodeType::Int && !__builtin_mul_overflow(a.AsInt(), b.AsInt(), &result))
+        return MalNode::Int(result);
+
+    return MultiplySlow(a, b);
+}
+
+inline MalNode DivideNumbers(const MalNode& a, const MalNode& b) {
+    // INT64_MIN / -1 is the one quotient of two Ints that overflows
+    if (a.Type() == MalType::NodeType::Int && b.Type() == MalType::NodeType::Int && b.AsInt() != 0 && b.AsInt() != -1)
+        return MalNode::Int(a.AsInt() / b.AsInt());
+
+    return DivideSlow(a, b);
+}
+
+/*
+ * @brief -1, 0 or 1 as a is less than, equal to or greater than b, which must be numbers
+ * */
+inline int CompareNumbers(const MalNode& a, const MalNode& b) {
+    if (a.Type() == MalType::NodeType::Int && b.Type() == MalType::NodeType::Int)
+        return (a.AsInt() > b.AsInt()) - (a.AsInt() < b.AsInt());
+
+    return CompareSlow(a, b);
+}
+
+/*
+ * @brief Decimal integer of any length, with an optional sign, as an Int or a BigInt
+ * */
+MalNode ParseInteger(std::string_view digits);
+
+#endif // MAL_NUMERIC_H
@@ -2,9 +2,20 @@
 #define MAL_PRINTER_H
 
 #include <string>
+#include <vector>
 
 #include "types.h"
 
 std::string PrintAst( [[ maybe_unused ]] MalNode node);
 
-#endif // MAL_PRINTER_H
\ No newline at end of file
+/*
+ * @brief Appends nodes to out, separated by single spaces when spaced
+ * */
+void PrintNodes(const std::vector<MalNode>& nodes, std::string& out, bool print_readably, bool spaced);
+
+/*
+ * @brief Prints nodes as one line on stdout, with a single write of one reused buffer
+ * */
+void PrintLine(const std::vector<MalNode>& nodes, bool print_readably);
+
+#endif // MAL_PRINTER_H
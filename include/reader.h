@@ -2,20 +2,55 @@
 #define MAL_READER_H
 
 #include <cstdint>
+#include <functional>
+#include <istream>
 #include <optional>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "types.h"
 
-using Token = std::string;
+/*
+ * @brief A token is a kind plus a view into the source buffer it was scanned from
+ * */
+struct Token {
+    enum class Kind {
+        Special,    // ~@ [ ] { } ( ) ' ` ~ ^ @
+        String,     // "...", possibly unterminated
+        Comment,    // ; up to the end of the line
+        Atom,       // symbols, numbers, keywords, nil/true/false
+        End         // end of input, empty text
+    };
+
+    Kind kind_;
+    std::string_view text_;
+};
+
+/*
+ * @brief Hand-written scanner equivalent to the regex
+ *
+ *   [\s,]*(~@|[\[\]{}()'`~^@]|"(?:\\.|[^\\"])*"?|;.*|[^\s\[\]{}('"`,;)]*)
+ *
+ * Tokens are views into the source, so the source must outlive them.
+ * Once the input is exhausted every call to Next() returns an End token.
+ * */
+class Lexer {
+public:
+    explicit Lexer(std::string_view src) : src_{src}, pos_{0} {}
 
-static std::string lisp_regex_str = "[\\s,]*(~@|[\\[\\]{}()'`~^@]|\"(?:\\\\.|[^\\\\\"])*\"?|;.*|[^\\s\\[\\]{}('\"`,;)]*)";
+    Token Next();
+
+private:
+    std::string_view src_;
+    std::size_t pos_;
+};
 
 class Reader {
 public:
-    Reader(std::string src) : src_{src}, tokens_{}, index_{} {}
+    Reader(std::string src) : src_{std::move(src)}, tokens_{}, index_{} {}
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
 
     void Tokenize();
     MalNode ReadForm();
@@ -32,8 +67,8 @@ public:
     MalNode ReadSequence();
 
 private:
-    std::optional<std::string> Next();
-    std::optional<std::string> Peek();
+    std::optional<std::string_view> Next();
+    std::optional<std::string_view> Peek();
 
 private:
     std::string src_;
@@ -41,6 +76,34 @@ private:
     std::size_t index_;
 };
 
+/*
+ * @brief Reads top-level forms one at a time from a file descriptor or stream
+ *
+ * Input is pulled in chunk_size pieces. Before each new piece the buffer is cut
+ * down to the form currently being read, so memory is bounded by the largest
+ * single form plus a chunk rather than by the size of the input.
+ * */
+class StreamReader {
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+
+    explicit StreamReader(int fd);
+    explicit StreamReader(std::istream& in);
+
+    std::optional<MalNode> NextForm();
+
+private:
+    bool Fill();
+    MalNode TakeForm(std::size_t end);
+
+private:
+    std::function<std::size_t(char*, std::size_t)> read_;
+    std::string buffer_;
+    std::size_t scan_pos_;
+    std::optional<std::size_t> form_start_;
+    int depth_;
+    bool eof_;
+};
 
 /*
  * @brief Creates a quote/quasiquote node
@@ -51,7 +114,7 @@ template<typename QuoteType>
 MalNode Reader::ReadQuote() {
     [[maybe_unused ]] auto quote = Next().value();
     auto node = ReadForm();
-    return std::make_shared<QuoteType>(node);
+    return MalNode::Make<QuoteType>(node);
 }
 
 /*
@@ -61,14 +124,14 @@ MalNode Reader::ReadQuote() {
  * */
 template<typename ListType>
 MalNode Reader::ReadSequence() {
-    MalNode node = std::make_shared<ListType>();
+    auto node = MalNode::Make<ListType>();
 
     Next(); // '(', '['
 
-    std::string termination_string = (std::is_same<ListType, List>::value) ? ")" : "]";
+    std::string_view termination_string = (std::is_same<ListType, List>::value) ? ")" : "]";
 
     while (Peek().has_value() && Peek().value() != termination_string && Peek().value() != "") {
-        static_cast<ListType*>(node.get())->children_.push_back(ReadForm());
+        node.template As<ListType>()->Add(ReadForm());
     }
 
     auto actual_terminator = Next().value(); // ')', ']'
@@ -15,5 +15,6 @@ MalNode EVAL(MalNode ast, Environment& env);
 std::string PRINT(MalNode ast);
 std::string rep(std::string line, Environment& env);
 void InitEnvironment(Environment& env);
+int RunFile(std::string path, Environment& env);
 
 #endif // MAL_REPFUNCS_H
\ No newline at end of file
@@ -1,143 +1,537 @@
 #ifndef MAL_TYPES_H
 #define MAL_TYPES_H
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
 #include <functional>
+#include <limits>
 #include <memory>
+#include <new>
 #include <sstream>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
-struct MalType {
-    enum class NodeType {
+#include "gc.h"
+#include "intern.h"
+
+class Environment;
+struct Chunk;
+
+/*
+ * @brief Base of every heap allocated value (collections, strings, functions)
+ *
+ * Heap values are reference counted by the MalNode handles pointing at them.
+ * The count is not atomic, values are not shared across threads. Values that
+ * can hold other values are tracked by the cycle collector.
+ * */
+struct MalType : GcObject {
+    // Heap types come first, MalNode::IsHeap() relies on Int being the first immediate
+    enum class NodeType : std::uint8_t {
         List,
         Vector,
         HashMap,
+        String,
+        Quote,
+        Quasiquote,
+        Unquote,
+        Builtin,
+        Closure,
+        Box,
+        LazySeq,
+        BigInt,
+        F64Array,
+        I64Array,
         Int,
         Double,
         Keyword,
-        String,
         Boolean,
         Symbol,
-        Quote,
-        Quasiquote,
-        Unquote,
-        Function,
         Nil
     };
 
-    MalType(NodeType type) : type_{type} {}
-    virtual ~MalType() {}
-    virtual std::string Print(bool print_readably) = 0;
-    virtual bool operator==(MalType& other) = 0;
+    MalType(NodeType type, bool tracked = true) : GcObject{tracked}, type_{type} {}
+    ~MalType() override {}
+
+    /*
+     * @brief Calls f with this value as its concrete type
+     *
+     * The value types are a closed set, so they are dispatched on type_ rather than
+     * through virtual calls, and nothing needs RTTI.
+     * */
+    template<typename F>
+    decltype(auto) Visit(F&& f);
+
+    /*
+     * @brief Appends the printed form to out, so nested values print in one buffer
+     * */
+    void PrintTo(std::string& out, bool print_readably);
+    std::string Print(bool print_readably);
+    bool operator==(MalType& other);
+
+    /*
+     * @brief Structural hash, equal for values that compare equal
+     * */
+    std::size_t Hash();
 
     MalType::NodeType type_;
 };
 
+/*
+ * @brief A MAL value
+ *
+ * Nil, Boolean, Int, Double, Symbol and Keyword are stored inline, interned
+ * names by id. Every other type points at a reference counted MalType.
+ * */
+class MalNode {
+public:
+    using NodeType = MalType::NodeType;
+
+    MalNode() noexcept : type_{NodeType::Nil}, int_{0} {}
+    MalNode(const MalNode& other) noexcept : type_{other.type_}, int_{other.int_} { Retain(); }
+    MalNode(MalNode&& other) noexcept : type_{other.type_}, int_{other.int_} { other.type_ = NodeType::Nil; }
+    ~MalNode() { Release(); }
+
+    MalNode& operator=(const MalNode& other) noexcept;
+    MalNode& operator=(MalNode&& other) noexcept;
+
+    static MalNode Nil() { return MalNode{}; }
+    static MalNode Boolean(bool b);
+    static MalNode Int(std::int64_t i);
+    static MalNode Double(double d);
+    static MalNode Symbol(InternId id);
+    static MalNode Keyword(InternId id);
+
+    template<typename T, typename... Args>
+    static MalNode Make(Args&&... args);
+
+    /*
+     * @brief Another handle to a heap value that is already held
+     * */
+    static MalNode Share(MalType* ptr) { return MalNode{ptr}; }
+
+    NodeType Type() const { return type_; }
+    bool IsHeap() const { return type_ < NodeType::Int; }
+    bool IsTruthy() const;
+
+    bool AsBool() const { return bool_; }
+    std::int64_t AsInt() const { return int_; }
+    double AsDouble() const { return double_; }
+    InternId AsId() const { return id_; }
+    MalType* Get() const { return IsHeap() ? ptr_ : nullptr; }
+
+    template<typename T>
+    T* As() const { return static_cast<T*>(ptr_); }
+
+    std::string Print(bool print_readably) const;
+    void PrintTo(std::string& out, bool print_readably) const;
+    bool operator==(const MalNode& other) const;
+    std::size_t Hash() const;
+
+private:
+    explicit MalNode(MalType* ptr) noexcept : type_{ptr->type_}, ptr_{ptr} { ptr_->Retain(); }
+
+    void Retain() const {
+        if (IsHeap())
+            ptr_->Retain();
+    }
+
+    void Release() {
+        if (IsHeap())
+            ptr_->Release();
+    }
+
+private:
+    NodeType type_;
+    union {
+        bool bool_;
+        std::int64_t int_;
+        double double_;
+        InternId id_;
+        MalType* ptr_;
+    };
+};
 
+static_assert(sizeof(MalNode) == 16);
 
-using MalNode = std::shared_ptr<MalType>;
+/*
+ * @brief Reports a value's heap object, if any, to a collector visitor
+ * */
+inline void TraceNode(GcVisitor& visitor, const MalNode& node) {
+    if (node.IsHeap())
+        visitor.Visit(node.Get());
+}
 
+/*
+ * @brief Lists, vectors and maps are not changed once shared, so their hash is computed
+ * once and kept in hash_. 0 means not computed yet, and is reset by changes in place.
+ * */
 struct List : MalType {
-    List() : MalType{NodeType::List}, children_{} {}
+    List() : MalType{NodeType::List}, children_{}, hash_{0} {}
     ~List() override  {}
 
     void Add(MalNode node);
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
 
     std::vector<MalNode> children_;
+    std::size_t hash_;
 };
 
+/*
+ * @brief Node of a Vector's 32-way trie: a leaf holds elements, a branch holds nodes of the
+ * level below. Nodes are shared between vectors, and copied before changing once shared.
+ * */
+struct VectorLeaf : GcObject {
+    VectorLeaf() : GcObject{true}, values_{} {}
+
+    void CopyFrom(const VectorLeaf& other) { values_ = other.values_; }
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    std::array<MalNode, 32> values_;
+};
+
+struct VectorBranch : GcObject {
+    VectorBranch() : GcObject{true}, children_{} {}
+
+    void CopyFrom(const VectorBranch& other) { children_ = other.children_; }
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    std::array<GcRef<GcObject>, 32> children_;
+};
+
+/*
+ * @brief Persistent vector: a 32-way trie of leaves plus a tail leaf for the last elements
+ *
+ * conj, assoc and subvec return new vectors that share all but the changed path with this
+ * one, so nth and assoc are O(log32 n), conj is amortized O(1) and subvec is O(1). A
+ * subvec is a window [start_, end_) of the elements, and the ones outside it stay
+ * reachable until the window is appended past them.
+ *
+ * A transient vector is changed in place by conj! and assoc!. Nodes no other vector
+ * references are written directly and shared ones are copied once, so building a vector
+ * this way costs about as much as a std::vector, and persistent! is O(1).
+ * */
 struct Vector : MalType {
-    Vector() : MalType{NodeType::Vector}, children_{} {}
+    static constexpr unsigned bits = 5;
+    static constexpr std::size_t width = std::size_t{1} << bits;
+    static constexpr std::size_t mask = width - 1;
+
+    Vector() : MalType{NodeType::Vector}, hash_{0}, root_{}, tail_{}, shift_{bits}, tail_offset_{0}, start_{0}, end_{0}, transient_{false} {}
     ~Vector() override { }
 
+    std::size_t Size() const { return end_ - start_; }
+    bool Empty() const { return end_ == start_; }
+    const MalNode& Nth(std::size_t index) const {
+        index += start_;
+        return LeafFor(index)->values_[index & mask];
+    }
+
+    /*
+     * @brief Appends in place, for a vector that is still being built and not yet shared
+     * */
     void Add(MalNode node);
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
 
-    std::vector<MalNode> children_;
+    /*
+     * @brief Replaces an element in place, index may be Size() to append
+     * */
+    void Replace(std::size_t index, MalNode node);
+
+    MalNode Transient() const;
+    bool IsTransient() const { return transient_; }
+    void Persist() { transient_ = false; }
+
+    MalNode Conj(MalNode node) const;
+    MalNode Assoc(std::size_t index, MalNode node) const;
+    MalNode Subvec(std::size_t start, std::size_t end) const;
+    std::vector<MalNode> Elements() const;
+
+    template<typename F>
+    void ForEach(F&& f) const {
+        for (auto index = start_; index < end_; ) {
+            auto& values = LeafFor(index)->values_;
+            auto leaf_end = std::min(end_, (index | mask) + 1);
+
+            for (; index < leaf_end; index++)
+                f(values[index & mask]);
+        }
+    }
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    std::size_t hash_;
+
+private:
+    VectorLeaf* LeafFor(std::size_t index) const {
+        if (index >= tail_offset_)
+            return static_cast<VectorLeaf*>(tail_.get());
+
+        auto node = root_.get();
+        for (auto level = shift_; level > 0; level -= bits)
+            node = static_cast<VectorBranch*>(node)->children_[(index >> level) & mask].get();
+
+        return static_cast<VectorLeaf*>(node);
+    }
+
+    MalNode Copy() const;
+    void Push(MalNode node);
+    void Set(std::size_t index, MalNode node);
+    void PushTail();
+    bool SameLayout(const Vector& other) const;
+
+private:
+    GcRef<GcObject> root_;          // VectorBranch, null until the first leaf moves out of the tail
+    GcRef<GcObject> tail_;          // VectorLeaf of the elements from tail_offset_ on
+    unsigned shift_;                // bits above the leaf index at the root's level
+    std::size_t tail_offset_;       // elements held in the trie
+    std::size_t start_;
+    std::size_t end_;
+    bool transient_;
+};
+
+/*
+ * @brief Node of a HashMap's hash array mapped trie
+ *
+ * Each of the 32 slots of a level is empty, holds one entry, or holds a child node for
+ * the keys sharing that slot, with entry_map_ and node_map_ marking which. Entries keep
+ * their key's hash, so nothing is rehashed as the trie grows. Once the hash bits run
+ * out, a node is a bucket of colliding entries searched in order.
+ * */
+struct HashMapNode : GcObject {
+    struct Entry {
+        std::size_t hash_;
+        MalNode key_;
+        MalNode value_;
+    };
+
+    HashMapNode() : GcObject{true}, entry_map_{0}, node_map_{0}, entries_{}, children_{} {}
+
+    void CopyFrom(const HashMapNode& other) {
+        entry_map_ = other.entry_map_;
+        node_map_ = other.node_map_;
+        entries_ = other.entries_;
+        children_ = other.children_;
+    }
+
+    template<typename F>
+    void ForEach(F& f) const {
+        for (auto& entry : entries_)
+            f(entry.key_, entry.value_);
+        for (auto& child : children_)
+            static_cast<const HashMapNode*>(child.get())->ForEach(f);
+    }
+
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    std::uint32_t entry_map_;
+    std::uint32_t node_map_;
+    std::vector<Entry> entries_;
+    std::vector<GcRef<GcObject>> children_;
 };
 
+/*
+ * @brief Persistent hash map keyed on any value, as a hash array mapped trie
+ *
+ * get, assoc and dissoc are O(log32 n). assoc and dissoc copy the path to the changed
+ * entry and share the rest with the old map. A transient map is changed in place by
+ * assoc! and dissoc!, copying only the nodes it still shares, as a transient Vector is.
+ * */
 struct HashMap : MalType {
-    HashMap() : MalType{NodeType::HashMap}, kv_{} {}
+    HashMap() : MalType{NodeType::HashMap}, hash_{0}, root_{}, size_{0}, transient_{false} {}
     ~HashMap() override  {}
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    std::size_t Size() const { return size_; }
 
-    std::unordered_map<std::string, MalNode> kv_;
-};
+    /*
+     * @brief Value bound to key, or nullptr
+     * */
+    const MalNode* Find(const MalNode& key) const;
 
-struct Int : MalType {
-    explicit Int(int i) : MalType{NodeType::Int}, num_{i} {}
-    ~Int() override { }
+    /*
+     * @brief Binds key in place, for a map that is still being built and not yet shared
+     * */
+    void Add(MalNode key, MalNode value);
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    /*
+     * @brief Unbinds key in place, for a map that is still being built or transient
+     * */
+    void Remove(const MalNode& key);
 
-    int num_;
-};
+    MalNode Transient() const;
+    bool IsTransient() const { return transient_; }
+    void Persist() { transient_ = false; }
 
-struct Double : MalType {
-    explicit Double(double d) : MalType{NodeType::Double}, num_{d} {}
-    ~Double() override {}
+    MalNode Assoc(MalNode key, MalNode value) const;
+    MalNode Dissoc(const MalNode& key) const;
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    template<typename F>
+    void ForEach(F&& f) const {
+        if (root_)
+            static_cast<const HashMapNode*>(root_.get())->ForEach(f);
+    }
 
-    double num_;
-};
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
 
-struct Keyword : MalType {
-    explicit Keyword(std::string keyword) : MalType(NodeType::Keyword), keyword_{keyword.substr(1, keyword.size() - 1)} {}
-    ~Keyword() override {}
+    std::size_t hash_;
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+private:
+    MalNode Copy() const;
 
-    std::string keyword_;
+private:
+    GcRef<GcObject> root_;          // HashMapNode, null while empty
+    std::size_t size_;
+    bool transient_;
 };
 
+/*
+ * @brief Immutable string, a flat leaf or, once longer than leaf_size, a rope
+ *
+ * A rope is a balanced tree of concatenations over leaves, so concatenating and taking
+ * a substring of long strings are O(log n) and share the characters of their operands.
+ * Ropes are flattened into s_ the first time they are compared or hashed. Strings only
+ * hold strings made before them, so they can not form cycles and are not tracked.
+ * */
 struct String : MalType {
-    explicit String(std::string s) : MalType{NodeType::String}, s_{s} {}
+    static constexpr std::size_t leaf_size = 512;
+
+    explicit String(std::string s) : MalType{NodeType::String, false}, s_{std::move(s)}, left_{}, right_{}, size_{s_.size()}, height_{0} {}
+    String(MalNode left, MalNode right);
     ~String() override {}
 
-    std::string PrintStr(bool print_readably);
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    std::size_t Size() const { return size_; }
+    bool IsRope() const { return left_.Type() == NodeType::String; }
+
+    /*
+     * @brief All the characters, flattening a rope on first use
+     * */
+    const std::string& Flat();
+
+    /*
+     * @brief Calls f on each run of characters in order, without flattening
+     * */
+    template<typename F>
+    void ForEachChunk(F&& f) const {
+        if (!IsRope() || !s_.empty()) {
+            f(s_);
+            return;
+        }
+
+        left_.As<String>()->ForEachChunk(f);
+        right_.As<String>()->ForEachChunk(f);
+    }
+
+    /*
+     * @brief Concatenation of two strings, a rope once the result is longer than leaf_size
+     * */
+    static MalNode Concat(const MalNode& left, const MalNode& right);
+
+    MalNode Substring(std::size_t start, std::size_t end) const;
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash() { return std::hash<std::string>{}(Flat()); }
+
+    std::string s_;             // characters of a leaf, or of a rope once flattened
+    MalNode left_;              // the halves of a rope, nil for a leaf
+    MalNode right_;
+    std::size_t size_;
+    std::uint8_t height_;       // 0 for a leaf
+};
+
+/*
+ * @brief Integer outside the range of Int, as a sign and a magnitude
+ *
+ * Integer arithmetic overflowing Int promotes to a BigInt, and a BigInt result that fits
+ * an Int again is returned as an Int, so no BigInt holds a value an Int could.
+ * */
+struct BigInt : MalType {
+    BigInt(bool negative, std::vector<std::uint32_t> limbs) : MalType{NodeType::BigInt, false}, negative_{negative}, limbs_{std::move(limbs)} {}
+    ~BigInt() override {}
 
-    std::string s_;
+    double ToDouble() const;
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+
+    bool negative_;
+    std::vector<std::uint32_t> limbs_;  // base 2^32, least significant first, no leading zeros
 };
 
-struct Boolean : MalType {
-    explicit Boolean(bool b) : MalType{NodeType::Boolean}, b_{b} {}
-    ~Boolean() override {}
+/*
+ * @brief Allocator of buffers aligned for 256 bit vector loads
+ * */
+template<typename T>
+struct AlignedAllocator {
+    using value_type = T;
+    static constexpr std::size_t alignment = 32;
+
+    AlignedAllocator() = default;
+    template<typename U>
+    AlignedAllocator(const AlignedAllocator<U>&) {}
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    T* allocate(std::size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignment})); }
+    void deallocate(T* ptr, std::size_t n) { ::operator delete(ptr, n * sizeof(T), std::align_val_t{alignment}); }
 
-    bool b_;
+    bool operator==(const AlignedAllocator&) const = default;
 };
 
-struct Symbol : MalType {
-    explicit Symbol(char symbol) : MalType{NodeType::Symbol}, symbol_{symbol} {}
-    explicit Symbol(std::string symbol) : MalType{NodeType::Symbol}, symbol_{symbol} { }
-    ~Symbol() override {}
+/*
+ * @brief An f64-array or an i64-array, numbers of one type packed in an aligned buffer
+ *
+ * Eight bytes per element instead of a MalNode each, and the arithmetic over them runs
+ * as vector kernels (see numarray.h). Arrays hold no references, so they are not tracked.
+ * */
+template<typename T>
+struct PackedArray : MalType {
+    static constexpr NodeType node_type = std::is_same_v<T, double> ? NodeType::F64Array : NodeType::I64Array;
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    explicit PackedArray(std::size_t size) : MalType{node_type, false}, data_(size) {}
+    ~PackedArray() override {}
 
-    std::string symbol_;
+    std::size_t Size() const { return data_.size(); }
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+
+    std::vector<T, AlignedAllocator<T>> data_;
 };
 
+using F64Array = PackedArray<double>;
+using I64Array = PackedArray<std::int64_t>;
+
+// Defined in numarray.cpp
+extern template struct PackedArray<double>;
+extern template struct PackedArray<std::int64_t>;
+
 struct Quote : MalType {
     explicit Quote(MalNode child) : MalType{NodeType::Quote}, child_{child} {}
     ~Quote() override {}
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash() { return child_.Hash() ^ static_cast<std::size_t>(type_); }
+    void Trace(GcVisitor& visitor) override { TraceNode(visitor, child_); }
+    void Clear() override { child_ = MalNode{}; }
 
     MalNode child_;
 };
@@ -146,8 +540,11 @@ struct Quasiquote : MalType {
     explicit Quasiquote(MalNode child) : MalType{NodeType::Quasiquote}, child_{child} {}
     ~Quasiquote() override {}
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash() { return child_.Hash() ^ static_cast<std::size_t>(type_); }
+    void Trace(GcVisitor& visitor) override { TraceNode(visitor, child_); }
+    void Clear() override { child_ = MalNode{}; }
 
     MalNode child_;
 };
@@ -156,33 +553,330 @@ struct Unquote : MalType {
     explicit Unquote(MalNode child) : MalType{NodeType::Unquote}, child_{child} {}
     ~Unquote() override {}
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash() { return child_.Hash() ^ static_cast<std::size_t>(type_); }
+    void Trace(GcVisitor& visitor) override { TraceNode(visitor, child_); }
+    void Clear() override { child_ = MalNode{}; }
 
     MalNode child_;
 };
 
+using BuiltinFn = MalNode (*)(std::vector<MalNode>&);
 
-struct Nil : MalType {
-    Nil() : MalType{NodeType::Nil} {}
-    ~Nil() override {}
+/*
+ * @brief A function implemented in C++, called through a plain function pointer
+ *
+ * Call checks the argument count against min_arity_ and max_arity_, so fn_ only has to
+ * check the types of its arguments.
+ * */
+struct Builtin : MalType {
+    static constexpr std::uint16_t variadic = std::numeric_limits<std::uint16_t>::max();
 
-    std::string Print(bool print_readably) override;
-    bool operator==(MalType& other) override;
-};
+    Builtin(const char* name, std::uint16_t min_arity, std::uint16_t max_arity, BuiltinFn fn) :
+        MalType{NodeType::Builtin, false}, name_{name}, min_arity_{min_arity}, max_arity_{max_arity}, fn_{fn} {}
+    ~Builtin() override {}
+
+    MalNode Call(std::vector<MalNode>& args) {
+        if (args.size() < min_arity_ || args.size() > max_arity_) [[unlikely]]
+            ThrowArity();
+
+        return fn_(args);
+    }
+
+    [[noreturn]] void ThrowArity() const;
+
+    void PrintTo(std::string& out, [[maybe_unused]] bool print_readably) { out += "function"; }
+    bool operator==(MalType& other) { return other.type_ == type_ && static_cast<Builtin*>(&other)->fn_ == fn_; }
+    std::size_t Hash() { return std::hash<BuiltinFn>{}(fn_); }
 
-using MalFunc = std::function<MalNode(std::vector<MalNode>&)>;
-struct Function : MalType {
-    Function(MalFunc func) : MalType{MalType::NodeType::Function}, func_{func} {}
-    ~Function() override {}
+    const char* name_;
+    std::uint16_t min_arity_;
+    std::uint16_t max_arity_;
+    BuiltinFn fn_;
+};
 
-    std::string Print(bool print_readably) override;
-    MalNode ApplyFn(std::vector<MalNode>& nodes);
-    bool operator==( [[maybe_unused]] MalType& other) override;
+/*
+ * @brief A function written in MAL: a closure over binds_, body_ and env_
+ *
+ * Closures keep their environment as data, so the collector can trace it and
+ * the evaluator binds and evaluates the body itself. Every closure holds the
+ * binds_ and body_ of its fn*. The tree-walking steps evaluate body_ in env_.
+ * The VM runs the compiled chunk_ with env_ as its globals, and with captures_,
+ * the values of the free variables of the body copied when the closure was
+ * made (see Capture in bytecode.h).
+ * */
+struct Closure : MalType {
+    Closure(std::vector<InternId> binds, MalNode body, GcRef<Environment> env, std::shared_ptr<const Chunk> chunk = {});
+    ~Closure() override;
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other) { return &other == this; }
+    std::size_t Hash() { return std::hash<const void*>{}(this); }
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    std::vector<InternId> binds_;
+    MalNode body_;
+    GcRef<Environment> env_;
+    std::shared_ptr<const Chunk> chunk_;  // compiled body, shared by every closure over it
+    std::vector<MalNode> captures_;
+};
 
-    std::function<MalNode(std::vector<MalNode>&)> func_;
+inline bool IsFunction(const MalNode& node) {
+    return node.Type() == MalType::NodeType::Builtin || node.Type() == MalType::NodeType::Closure;
+}
+
+using ClosureApply = MalNode (*)(const MalNode& closure, std::vector<MalNode>& args);
+
+/*
+ * @brief Sets how ApplyFunction calls a Closure
+ *
+ * The VM and the tree-walking steps run closures differently, each evaluator registers
+ * its own apply when it starts.
+ * */
+void SetClosureApply(ClosureApply apply);
+
+/*
+ * @brief Calls a function from C++, e.g. from a lazy seq: a Builtin directly, a Closure
+ * through the apply of the running evaluator
+ * */
+MalNode ApplyFunction(const MalNode& fn, std::vector<MalNode>& args);
+
+/*
+ * @brief A variable shared by a VM frame and the closures that captured it
+ *
+ * Only variables that can change after a closure copies them are boxed. Boxes live in
+ * frame slots and captures, the VM loads what they hold, so programs never see one.
+ * */
+struct Box : MalType {
+    explicit Box(MalNode value) : MalType{NodeType::Box}, value_{std::move(value)} {}
+    ~Box() override {}
+
+    void PrintTo(std::string& out, bool print_readably) { value_.PrintTo(out, print_readably); }
+    bool operator==(MalType& other) { return other.type_ == type_ && value_ == static_cast<Box*>(&other)->value_; }
+    std::size_t Hash() { return value_.Hash(); }
+    void Trace(GcVisitor& visitor) override { TraceNode(visitor, value_); }
+    void Clear() override { value_ = MalNode{}; }
+
+    MalNode value_;
 };
 
+/*
+ * @brief Sequence whose elements are produced on demand, chunk_size at a time
+ *
+ * An unrealized seq holds a producer, kind_ and the fields it uses. Realize runs it once,
+ * leaving the next elements in chunk_ and the seq of the ones after them in rest_ (nil at
+ * the end), and drops the producer. A chunk can be empty, e.g. when filter rejects a whole
+ * chunk of its input, or when a lazy-seq body returns a list that becomes rest_.
+ * */
+struct LazySeq : MalType {
+    static constexpr std::size_t chunk_size = 32;
+
+    enum class Kind : std::uint8_t {
+        Thunk,      // the seq fn_ returns
+        Range,      // count_ integers from state_ by step_, without end when count_ is -1, going on in BigInts past the Int range
+        Iterate,    // state_, then fn_ applied to it over and over; count_ is 1 once state_ was produced
+        Map,        // fn_ of each element of source_
+        Filter,     // the elements of source_ that fn_ is truthy for
+        Take,       // the first count_ elements of source_
+        Drop,       // the elements of source_, which drop skips by starting at a later offset_
+        Realized
+    };
+
+    explicit LazySeq(Kind kind) : MalType{NodeType::LazySeq}, kind_{kind}, fn_{}, source_{}, offset_{0}, state_{}, count_{0}, step_{0}, chunk_{}, rest_{} {}
+    ~LazySeq() override;
+
+    static MalNode Thunk(MalNode fn);
+    static MalNode Range(MalNode start, std::int64_t count, std::int64_t step);
+    static MalNode Iterate(MalNode fn, MalNode x);
+    static MalNode Map(MalNode fn, MalNode source, std::size_t offset = 0);
+    static MalNode Filter(MalNode fn, MalNode source, std::size_t offset = 0);
+    static MalNode Take(std::int64_t count, MalNode source, std::size_t offset = 0);
+    static MalNode Drop(std::int64_t count, MalNode source, std::size_t offset = 0);
+
+    /*
+     * @brief The seq of x followed by the elements of seq, which is not realized
+     * */
+    static MalNode Cons(MalNode x, MalNode seq);
+
+    /*
+     * @brief Runs the producer, once, calling functions through ApplyFunction
+     * */
+    void Realize();
+
+    void PrintTo(std::string& out, bool print_readably);
+    bool operator==(MalType& other);
+    std::size_t Hash();
+    void Trace(GcVisitor& visitor) override;
+    void Clear() override;
+
+    Kind kind_;
+    MalNode fn_;
+    MalNode source_;            // input seq, read from its element offset_ on
+    std::size_t offset_;
+    MalNode state_;
+    std::int64_t count_;
+    std::int64_t step_;
+    std::vector<MalNode> chunk_;
+    MalNode rest_;
+};
 
+/*
+ * @brief Whether node is nil, a list, a vector or a lazy seq, which SeqCursor walks
+ * */
+inline bool IsSeq(const MalNode& node) {
+    switch (node.Type()) {
+        case MalType::NodeType::Nil:
+        case MalType::NodeType::List:
+        case MalType::NodeType::Vector:
+        case MalType::NodeType::LazySeq:
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*
+ * @brief Walks the elements of a seq in order, from element offset on
+ *
+ * Lazy seqs are realized a chunk at a time as the cursor reaches them. The cursor only
+ * holds the part of the seq it is in, so walking a seq nothing else holds frees the
+ * chunks behind it.
+ *
+ *     for (SeqCursor cursor {seq}; !cursor.Done(); cursor.Next())
+ *         use(cursor.Get());
+ * */
+class SeqCursor {
+public:
+    explicit SeqCursor(MalNode seq, std::size_t offset = 0);
+
+    bool Done();
+
+    /*
+     * @brief The current element, after Done returned false
+     * */
+    const MalNode& Get() const;
+    void Next() { offset_++; }
+
+    /*
+     * @brief The seq of the elements from the current one on
+     * */
+    MalNode Rest() const;
+
+    const MalNode& Seq() const { return seq_; }
+    std::size_t Offset() const { return offset_; }
+
+private:
+    MalNode seq_;
+    std::size_t offset_;
+};
 
-#endif // MAL_TYPES_H
\ No newline at end of file
+template<typename F>
+decltype(auto) MalType::Visit(F&& f) {
+    switch (type_) {
+        case NodeType::List:
+            return f(*static_cast<List*>(this));
+        case NodeType::Vector:
+            return f(*static_cast<Vector*>(this));
+        case NodeType::HashMap:
+            return f(*static_cast<HashMap*>(this));
+        case NodeType::String:
+            return f(*static_cast<String*>(this));
+        case NodeType::Quote:
+            return f(*static_cast<Quote*>(this));
+        case NodeType::Quasiquote:
+            return f(*static_cast<Quasiquote*>(this));
+        case NodeType::Unquote:
+            return f(*static_cast<Unquote*>(this));
+        case NodeType::Builtin:
+            return f(*static_cast<Builtin*>(this));
+        case NodeType::Closure:
+            return f(*static_cast<Closure*>(this));
+        case NodeType::Box:
+            return f(*static_cast<Box*>(this));
+        case NodeType::LazySeq:
+            return f(*static_cast<LazySeq*>(this));
+        case NodeType::BigInt:
+            return f(*static_cast<BigInt*>(this));
+        case NodeType::F64Array:
+            return f(*static_cast<F64Array*>(this));
+        case NodeType::I64Array:
+            return f(*static_cast<I64Array*>(this));
+        default:
+            // Immediate types are never heap objects
+            std::unreachable();
+    }
+}
+
+inline MalNode& MalNode::operator=(const MalNode& other) noexcept {
+    other.Retain();
+    Release();
+    type_ = other.type_;
+    int_ = other.int_;
+    return *this;
+}
+
+inline MalNode& MalNode::operator=(MalNode&& other) noexcept {
+    if (this != &other) {
+        Release();
+        type_ = other.type_;
+        int_ = other.int_;
+        other.type_ = NodeType::Nil;
+    }
+    return *this;
+}
+
+inline MalNode MalNode::Boolean(bool b) {
+    MalNode node;
+    node.type_ = NodeType::Boolean;
+    node.int_ = 0;
+    node.bool_ = b;
+    return node;
+}
+
+inline MalNode MalNode::Int(std::int64_t i) {
+    MalNode node;
+    node.type_ = NodeType::Int;
+    node.int_ = i;
+    return node;
+}
+
+inline MalNode MalNode::Double(double d) {
+    MalNode node;
+    node.type_ = NodeType::Double;
+    node.double_ = d;
+    return node;
+}
+
+inline MalNode MalNode::Symbol(InternId id) {
+    MalNode node;
+    node.type_ = NodeType::Symbol;
+    node.id_ = id;
+    return node;
+}
+
+inline MalNode MalNode::Keyword(InternId id) {
+    MalNode node;
+    node.type_ = NodeType::Keyword;
+    node.id_ = id;
+    return node;
+}
+
+/*
+ * @brief Allocates a heap value, the returned handle holds the only reference
+ * */
+template<typename T, typename... Args>
+MalNode MalNode::Make(Args&&... args) {
+    Gc::Instance().MaybeCollect();
+    return MalNode{new T(std::forward<Args>(args)...)};
+}
+
+/*
+ * @brief Everything except nil and false is true
+ * */
+inline bool MalNode::IsTruthy() const {
+    return !(type_ == NodeType::Nil || (type_ == NodeType::Boolean && !bool_));
+}
+
+#endif // MAL_TYPES_H
@@ -0,0 +1,69 @@
+#ifndef MAL_VM_H
+#define MAL_VM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bytecode.h"
+#include "environment.h"
+#include "gc.h"
+
+/*
+ * @brief Stack machine that runs compiled Chunks
+ *
+ * Every call frame owns a window of the operand stack: the callee, its parameter and
+ * let* slots, then its operands. Tail calls reuse the caller's window, so tail
+ * recursion runs in constant space. Slots above the top of the stack are kept nil,
+ * so the collector only sees live values.
+ * */
+class VM {
+public:
+    static constexpr std::size_t stack_size = 256 * 1024;
+
+    static VM& Instance();
+
+    /*
+     * @brief Runs a top-level chunk in env
+     *
+     * @return Value of the form
+     * */
+    MalNode Run(std::shared_ptr<const Chunk> chunk, Environment& env);
+
+    /*
+     * @brief Calls a function from outside the dispatch loop, e.g. from a builtin
+     *
+     * A closure runs in frames pushed above the current top of the stack, with the
+     * globals it was created under, so it can also be called once Run has returned.
+     *
+     * @return Value of the call
+     * */
+    MalNode Call(const MalNode& callee, std::vector<MalNode>& args);
+
+private:
+    VM();
+
+    struct Frame {
+        const Chunk* chunk_;
+        const std::uint8_t* ip_;
+        std::size_t base_;
+        const MalNode* captures_;   // of the closure in the callee slot
+    };
+
+    MalNode Execute(std::size_t entry_depth);
+
+    /*
+     * @brief Drops the frames and stack slots pushed since entry, after an exception
+     * */
+    void Unwind(std::size_t entry_depth, std::size_t entry_sp);
+
+private:
+    std::vector<MalNode> stack_;
+    std::size_t sp_;
+    std::vector<Frame> frames_;
+    Environment* globals_;
+    std::uint64_t globals_id_;
+};
+
+#endif // MAL_VM_H
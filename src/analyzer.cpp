@@ -0,0 +1,189 @@
+#include "../include/analyzer.h"
+
+#include <algorithm>
+#include <ranges>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+
+/*
+ * @brief Elements of a list or vector form, such as a let* binding list
+ * */
+std::vector<MalNode> Elements(const MalNode& form, const std::string& what) {
+    if (form.Type() == MalType::NodeType::List)
+        return form.As<List>()->children_;
+    if (form.Type() == MalType::NodeType::Vector)
+        return form.As<Vector>()->Elements();
+
+    throw std::logic_error(what + " must be a list or a vector!");
+}
+
+InternId SymbolId(const MalNode& form, const std::string& what) {
+    if (form.Type() != MalType::NodeType::Symbol)
+        throw std::logic_error(what + " must be a symbol!");
+
+    return form.AsId();
+}
+
+/*
+ * @brief True if the form evaluates to itself, so it can be hoisted as a constant
+ * */
+bool IsLiteral(const MalNode& form) {
+    switch (form.Type()) {
+        case MalType::NodeType::Symbol:
+            return false;
+        case MalType::NodeType::List:
+            return form.As<List>()->children_.empty();
+        case MalType::NodeType::Vector: {
+            bool literal = true;
+            form.As<Vector>()->ForEach([&](const MalNode& child) { literal = literal && IsLiteral(child); });
+            return literal;
+        }
+        case MalType::NodeType::HashMap: {
+            bool literal = true;
+            form.As<HashMap>()->ForEach([&]([[maybe_unused]] const MalNode& key, const MalNode& value) {
+                literal = literal && IsLiteral(value);
+            });
+            return literal;
+        }
+        default:
+            return true;
+    }
+}
+
+/*
+ * @brief A fn* of binds over body, whose own bindings are analyzed in a Scope of their own
+ * */
+CodePtr AnalyzeLambda(std::vector<InternId> binds, const MalNode& body) {
+    std::vector<InternId> defines;
+    Scope body_scope {.defines_ = &defines};
+    auto body_code = Analyze(body, body_scope);
+
+    return std::make_shared<Lambda>(std::move(binds), std::move(body_code), std::move(defines), body);
+}
+
+/*
+ * @brief Builtin wrapping a function of no arguments into the lazy seq it returns
+ * */
+const MalNode& MakeLazySeq() {
+    static const MalNode make_lazy_seq = MalNode::Make<Builtin>("lazy-seq", 1, 1, [](std::vector<MalNode>& nodes) -> MalNode {
+        return LazySeq::Thunk(nodes[0]);
+    });
+
+    return make_lazy_seq;
+}
+
+CodePtr AnalyzeList(const std::vector<MalNode>& children, Scope& scope) {
+    if (children[0].Type() == MalType::NodeType::Symbol) {
+        switch (children[0].AsId()) {
+            case SpecialForm::Def: {
+                if (children.size() != 3)
+                    throw std::logic_error("def! takes a symbol and a value!");
+
+                auto symbol = SymbolId(children[1], "def! name");
+                if (scope.defines_ != nullptr && std::ranges::find(*scope.defines_, symbol) == scope.defines_->end())
+                    scope.defines_->push_back(symbol);
+
+                return std::make_shared<Define>(symbol, Analyze(children[2], scope));
+            }
+            case SpecialForm::Let: {
+                if (children.size() != 3)
+                    throw std::logic_error("let* takes bindings and a body!");
+
+                auto binding_list = Elements(children[1], "let* bindings");
+
+                std::vector<InternId> defines;
+                auto enclosing_defines = std::exchange(scope.defines_, &defines);
+
+                std::vector<std::pair<InternId, CodePtr>> bindings;
+                for (std::size_t i = 0; i + 1 < binding_list.size(); i += 2)
+                    bindings.emplace_back(SymbolId(binding_list[i], "let* binding"), Analyze(binding_list[i+1], scope));
+                auto body = Analyze(children[2], scope);
+
+                scope.defines_ = enclosing_defines;
+
+                return std::make_shared<Let>(std::move(bindings), std::move(body), std::move(defines));
+            }
+            case SpecialForm::Do: {
+                std::vector<CodePtr> forms;
+                for (auto& child : children | std::views::drop(1))
+                    forms.push_back(Analyze(child, scope));
+
+                if (forms.empty())
+                    return std::make_shared<Constant>(MalNode::Nil());
+
+                return std::make_shared<Do>(std::move(forms));
+            }
+            case SpecialForm::If: {
+                if (children.size() != 3 && children.size() != 4)
+                    throw std::logic_error("if takes a condition and one or two branches!");
+
+                auto otherwise = (children.size() == 4) ? Analyze(children[3], scope) : std::make_shared<Constant>(MalNode::Nil());
+
+                return std::make_shared<If>(Analyze(children[1], scope), Analyze(children[2], scope), std::move(otherwise));
+            }
+            case SpecialForm::Fn: {
+                if (children.size() != 3)
+                    throw std::logic_error("fn* takes parameters and a body!");
+
+                std::vector<InternId> binds;
+                for (auto& var : Elements(children[1], "fn* parameters"))
+                    binds.push_back(SymbolId(var, "fn* parameter"));
+
+                return AnalyzeLambda(std::move(binds), children[2]);
+            }
+            case SpecialForm::LazySeq: {
+                // (lazy-seq body...) is a seq over (fn* () (do body...)), called once when first walked
+                auto body = MalNode::Make<List>();
+                body.As<List>()->children_.assign(children.begin(), children.end());
+                body.As<List>()->children_[0] = MalNode::Symbol(SpecialForm::Do);
+
+                std::vector<CodePtr> args {AnalyzeLambda({}, body)};
+                return std::make_shared<Call>(std::make_shared<Constant>(MakeLazySeq()), std::move(args));
+            }
+            default:
+                break;
+        }
+    }
+
+    std::vector<CodePtr> args;
+    args.reserve(children.size() - 1);
+    for (auto& child : children | std::views::drop(1))
+        args.push_back(Analyze(child, scope));
+
+    return std::make_shared<Call>(Analyze(children[0], scope), std::move(args));
+}
+
+} // namespace
+
+CodePtr Analyze(const MalNode& form, Scope& scope) {
+    if (IsLiteral(form))
+        return std::make_shared<Constant>(form);
+
+    switch (form.Type()) {
+        case MalType::NodeType::Symbol:
+            return std::make_shared<Lookup>(form.AsId());
+        case MalType::NodeType::List:
+            return AnalyzeList(form.As<List>()->children_, scope);
+        case MalType::NodeType::Vector: {
+            std::vector<CodePtr> elements;
+            form.As<Vector>()->ForEach([&](const MalNode& child) {
+                elements.push_back(Analyze(child, scope));
+            });
+
+            return std::make_shared<VectorLiteral>(std::move(elements));
+        }
+        case MalType::NodeType::HashMap: {
+            std::vector<std::pair<CodePtr, CodePtr>> entries;
+            // Keys are not evaluated, only values
+            form.As<HashMap>()->ForEach([&](const MalNode& key, const MalNode& value) {
+                entries.emplace_back(std::make_shared<Constant>(key), Analyze(value, scope));
+            });
+
+            return std::make_shared<HashMapLiteral>(std::move(entries));
+        }
+        default:
+            return std::make_shared<Constant>(form);
+    }
+}
@@ -0,0 +1,70 @@
+#include "../include/arena.h"
+
+#include <algorithm>
+#include <functional>
+
+/*
+ * @brief The arena is never destroyed, objects released during static
+ * destruction still return their memory to it
+ * */
+Arena& Arena::Instance() {
+    static Arena* arena = new Arena;
+    return *arena;
+}
+
+Arena::Arena() : free_lists_{}, cursor_{nullptr}, end_{nullptr}, blocks_{} {}
+
+void Arena::NewBlock() {
+    // The tail of the old block is too small for this size, so it is handed to smaller classes
+    while (static_cast<std::size_t>(end_ - cursor_) >= granule) {
+        auto size = std::min(static_cast<std::size_t>(end_ - cursor_), max_small) / granule * granule;
+        Free(cursor_, size);
+        cursor_ += size;
+    }
+
+    cursor_ = static_cast<char*>(::operator new(block_size));
+    end_ = cursor_ + block_size;
+    blocks_.push_back(cursor_);
+}
+
+void Arena::Trim() {
+    std::ranges::sort(blocks_, std::less<>{});
+    auto block_of = [&](const void* ptr) {
+        auto it = std::ranges::upper_bound(blocks_, static_cast<const char*>(ptr), std::less<>{});
+        return static_cast<std::size_t>(it - blocks_.begin()) - 1;
+    };
+
+    // Free bytes in each block: its objects on the free lists, and for the current block
+    // the part the bump pointer has not reached
+    std::vector<std::size_t> free_bytes(blocks_.size(), 0);
+    for (std::size_t size_class = 0; size_class < free_lists_.size(); size_class++) {
+        for (auto free = free_lists_[size_class]; free != nullptr; free = free->next_)
+            free_bytes[block_of(free)] += (size_class + 1) * granule;
+    }
+    if (end_ != nullptr)
+        free_bytes[block_of(end_ - 1)] += static_cast<std::size_t>(end_ - cursor_);
+
+    auto unused = [&](const void* ptr) { return free_bytes[block_of(ptr)] == block_size; };
+    if (std::ranges::none_of(blocks_, unused))
+        return;
+
+    for (auto& head : free_lists_) {
+        for (auto link = &head; *link != nullptr;) {
+            if (unused(*link))
+                *link = (*link)->next_;
+            else
+                link = &(*link)->next_;
+        }
+    }
+    if (end_ != nullptr && unused(end_ - 1))
+        cursor_ = end_ = nullptr;
+
+    std::vector<char*> kept;
+    for (std::size_t index = 0; index < blocks_.size(); index++) {
+        if (free_bytes[index] == block_size)
+            ::operator delete(blocks_[index]);
+        else
+            kept.push_back(blocks_[index]);
+    }
+    blocks_ = std::move(kept);
+}
@@ -0,0 +1,120 @@
+#include "../include/bytecode.h"
+
+#include <iomanip>
+#include <sstream>
+
+int OperandCount(OpCode op) {
+    switch (op) {
+        case OpCode::Constant:
+        case OpCode::LoadLocal:
+        case OpCode::StoreLocal:
+        case OpCode::LoadBoxed:
+        case OpCode::StoreBoxed:
+        case OpCode::LoadCapture:
+        case OpCode::LoadCaptureBoxed:
+        case OpCode::LoadGlobal:
+        case OpCode::DefineGlobal:
+        case OpCode::Jump:
+        case OpCode::JumpIfFalse:
+        case OpCode::Call:
+        case OpCode::TailCall:
+        case OpCode::Closure:
+        case OpCode::MakeVector:
+        case OpCode::MakeHashMap:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+const char* OpName(OpCode op) {
+    switch (op) {
+        case OpCode::Constant: return "CONSTANT";
+        case OpCode::Nil: return "NIL";
+        case OpCode::True: return "TRUE";
+        case OpCode::False: return "FALSE";
+        case OpCode::Pop: return "POP";
+        case OpCode::LoadLocal: return "LOAD_LOCAL";
+        case OpCode::StoreLocal: return "STORE_LOCAL";
+        case OpCode::LoadBoxed: return "LOAD_BOXED";
+        case OpCode::StoreBoxed: return "STORE_BOXED";
+        case OpCode::LoadCapture: return "LOAD_CAPTURE";
+        case OpCode::LoadCaptureBoxed: return "LOAD_CAPTURE_BOXED";
+        case OpCode::LoadGlobal: return "LOAD_GLOBAL";
+        case OpCode::DefineGlobal: return "DEFINE_GLOBAL";
+        case OpCode::Jump: return "JUMP";
+        case OpCode::JumpIfFalse: return "JUMP_IF_FALSE";
+        case OpCode::Call: return "CALL";
+        case OpCode::TailCall: return "TAIL_CALL";
+        case OpCode::Return: return "RETURN";
+        case OpCode::Closure: return "CLOSURE";
+        case OpCode::MakeVector: return "MAKE_VECTOR";
+        case OpCode::MakeHashMap: return "MAKE_HASH_MAP";
+        default: return "UNKNOWN";
+    }
+}
+
+namespace {
+
+void DisassembleInto(const Chunk& chunk, std::stringstream& ss) {
+    ss << "== " << chunk.name_ << " (arity " << chunk.arity_ << (chunk.variadic_ ? "+" : "")
+       << ", locals " << chunk.locals_ << ") ==\n";
+
+    for (std::size_t index = 0; index < chunk.captures_.size(); index++) {
+        auto& capture = chunk.captures_[index];
+        ss << "capture " << index << ": " << InternTable::Instance().Name(capture.symbol_)
+           << (capture.local_ ? " <- slot " : " <- capture ") << capture.index_ << (capture.boxed_ ? ", boxed" : "") << "\n";
+    }
+
+    for (std::size_t offset = 0; offset < chunk.code_.size(); ) {
+        auto op = static_cast<OpCode>(chunk.code_[offset]);
+        ss << std::setw(4) << std::setfill('0') << offset << std::setfill(' ') << "  ";
+        offset++;
+
+        if (OperandCount(op) == 0)
+            ss << OpName(op);
+        else {
+            auto operand = chunk.code_[offset] | (chunk.code_[offset + 1] << 8);
+            offset += 2;
+
+            ss << std::left << std::setw(14) << OpName(op) << std::right << " " << operand;
+            switch (op) {
+                case OpCode::Constant:
+                    ss << "  ; " << chunk.constants_[operand].Print(true);
+                    break;
+                case OpCode::LoadGlobal:
+                case OpCode::DefineGlobal:
+                    ss << "  ; " << InternTable::Instance().Name(chunk.globals_[operand].symbol_);
+                    break;
+                case OpCode::Jump:
+                case OpCode::JumpIfFalse:
+                    ss << "  ; -> " << offset + operand;
+                    break;
+                case OpCode::LoadCapture:
+                case OpCode::LoadCaptureBoxed:
+                    ss << "  ; " << InternTable::Instance().Name(chunk.captures_[operand].symbol_);
+                    break;
+                case OpCode::Closure:
+                    ss << "  ; " << chunk.functions_[operand]->name_;
+                    break;
+                default:
+                    break;
+            }
+        }
+        ss << "\n";
+    }
+
+    for (auto& function : chunk.functions_) {
+        ss << "\n";
+        DisassembleInto(*function, ss);
+    }
+}
+
+} // namespace
+
+std::string Disassemble(const Chunk& chunk) {
+    std::stringstream ss;
+    DisassembleInto(chunk, ss);
+
+    return ss.str();
+}
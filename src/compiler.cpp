@@ -0,0 +1,388 @@
+#include "../include/compiler.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+/*
+ * @brief Net change in operand stack depth of an instruction
+ * */
+int StackEffect(OpCode op, std::uint16_t operand) {
+    switch (op) {
+        case OpCode::Constant:
+        case OpCode::Nil:
+        case OpCode::True:
+        case OpCode::False:
+        case OpCode::LoadLocal:
+        case OpCode::LoadBoxed:
+        case OpCode::LoadCapture:
+        case OpCode::LoadCaptureBoxed:
+        case OpCode::LoadGlobal:
+        case OpCode::Closure:
+            return 1;
+        case OpCode::Pop:
+        case OpCode::StoreLocal:
+        case OpCode::StoreBoxed:
+        case OpCode::JumpIfFalse:
+        case OpCode::Return:
+            return -1;
+        case OpCode::Call:
+        case OpCode::TailCall:
+            return -operand;
+        case OpCode::MakeVector:
+            return 1 - operand;
+        case OpCode::MakeHashMap:
+            return 1 - 2 * operand;
+        default:
+            return 0;
+    }
+}
+
+std::uint16_t CheckOperand(std::size_t value, const char* what) {
+    if (value > std::numeric_limits<std::uint16_t>::max())
+        throw std::logic_error(std::string{"too many "} + what + " in one function!");
+
+    return static_cast<std::uint16_t>(value);
+}
+
+} // namespace
+
+Compiler::Compiler(std::string name, Compiler* enclosing) :
+    chunk_{std::make_shared<Chunk>()}, enclosing_{enclosing}, blocks_{}, next_slot_{0}, depth_{0}, max_depth_{0}, function_name_{} {
+    chunk_->name_ = std::move(name);
+}
+
+void Compiler::Adjust(int delta) {
+    depth_ += delta;
+    if (depth_ > max_depth_)
+        max_depth_ = depth_;
+}
+
+void Compiler::Emit(OpCode op) {
+    chunk_->code_.push_back(static_cast<std::uint8_t>(op));
+    Adjust(StackEffect(op, 0));
+}
+
+void Compiler::Emit(OpCode op, std::uint16_t operand) {
+    chunk_->code_.push_back(static_cast<std::uint8_t>(op));
+    chunk_->code_.push_back(static_cast<std::uint8_t>(operand & 0xff));
+    chunk_->code_.push_back(static_cast<std::uint8_t>(operand >> 8));
+    Adjust(StackEffect(op, operand));
+}
+
+std::size_t Compiler::EmitJump(OpCode op) {
+    Emit(op, 0);
+    return chunk_->code_.size() - 2;
+}
+
+void Compiler::PatchJump(std::size_t at) {
+    auto offset = CheckOperand(chunk_->code_.size() - (at + 2), "bytes");
+
+    chunk_->code_[at] = static_cast<std::uint8_t>(offset & 0xff);
+    chunk_->code_[at + 1] = static_cast<std::uint8_t>(offset >> 8);
+}
+
+std::uint16_t Compiler::AddConstant(MalNode value) {
+    auto& constants = chunk_->constants_;
+
+    // Immediates (symbols, numbers, ...) are shared, heap values are kept as is
+    if (!value.IsHeap()) {
+        for (std::size_t index = 0; index < constants.size(); index++)
+            if (!constants[index].IsHeap() && constants[index] == value)
+                return static_cast<std::uint16_t>(index);
+    }
+
+    constants.push_back(std::move(value));
+    return CheckOperand(constants.size() - 1, "constants");
+}
+
+std::uint16_t Compiler::AddFunction(std::shared_ptr<const Chunk> function) {
+    chunk_->functions_.push_back(std::move(function));
+    return CheckOperand(chunk_->functions_.size() - 1, "functions");
+}
+
+std::uint16_t Compiler::AddGlobal(InternId symbol) {
+    auto& globals = chunk_->globals_;
+
+    for (std::size_t index = 0; index < globals.size(); index++)
+        if (globals[index].symbol_ == symbol)
+            return static_cast<std::uint16_t>(index);
+
+    globals.push_back(GlobalSite{symbol});
+    return CheckOperand(globals.size() - 1, "globals");
+}
+
+void Compiler::BeginBlock() {
+    blocks_.push_back(Block{});
+}
+
+void Compiler::EndBlock() {
+    blocks_.pop_back();
+}
+
+Compiler::Location Compiler::Declare(InternId symbol, bool rebound) {
+    auto& block = blocks_.back();
+
+    for (auto& binding : block.bindings_) {
+        if (binding.symbol_ == symbol) {
+            binding.rebound_ = binding.rebound_ || rebound;
+            return Location{Location::Kind::Local, binding.slot_, symbol, binding.boxed_};
+        }
+    }
+
+    auto slot = next_slot_;
+    next_slot_ = CheckOperand(next_slot_ + 1, "locals");
+    if (next_slot_ > chunk_->locals_)
+        chunk_->locals_ = next_slot_;
+
+    block.bindings_.push_back(Binding{symbol, slot, true, rebound, false});
+
+    return Location{Location::Kind::Local, slot, symbol, false};
+}
+
+void Compiler::Settle(InternId symbol) {
+    for (auto& binding : blocks_.back().bindings_)
+        if (binding.symbol_ == symbol)
+            binding.pending_ = false;
+}
+
+Compiler::Binding* Compiler::FindBinding(InternId symbol, bool pending) {
+    for (auto block = blocks_.rbegin(); block != blocks_.rend(); block++)
+        for (auto it = block->bindings_.rbegin(); it != block->bindings_.rend(); it++)
+            if (it->symbol_ == symbol && (pending || !it->pending_))
+                return &*it;
+
+    return nullptr;
+}
+
+Compiler::Location Compiler::Resolve(InternId symbol) {
+    // This function's own pending bindings are not stored yet, the name means what it did before
+    if (auto binding = FindBinding(symbol, false))
+        return Location{Location::Kind::Local, binding->slot_, symbol, binding->boxed_};
+
+    return ResolveCapture(symbol);
+}
+
+Compiler::Location Compiler::ResolveCapture(InternId symbol) {
+    auto& captures = chunk_->captures_;
+    for (std::size_t index = 0; index < captures.size(); index++)
+        if (captures[index].symbol_ == symbol)
+            return Location{Location::Kind::Capture, static_cast<std::uint16_t>(index), symbol, captures[index].boxed_};
+
+    if (enclosing_ == nullptr)
+        return Location{Location::Kind::Global, 0, symbol, false};
+
+    Location outer;
+    if (auto binding = enclosing_->FindBinding(symbol, true)) {
+        // A closure made before the binding is stored, or before def! binds it again, would
+        // copy a stale value, so the frame and the closures share it in a box instead
+        if (binding->pending_ || binding->rebound_)
+            binding->boxed_ = true;
+
+        outer = Location{Location::Kind::Local, binding->slot_, symbol, binding->boxed_};
+    } else {
+        outer = enclosing_->ResolveCapture(symbol);
+        if (outer.kind_ == Location::Kind::Global)
+            return outer;
+    }
+
+    captures.push_back(Capture{symbol, outer.slot_, outer.kind_ == Location::Kind::Local, outer.boxed_});
+    return Location{Location::Kind::Capture, CheckOperand(captures.size() - 1, "captures"), symbol, outer.boxed_};
+}
+
+void Compiler::EmitLoad(const Location& location) {
+    switch (location.kind_) {
+        case Location::Kind::Local:
+            Emit(location.boxed_ ? OpCode::LoadBoxed : OpCode::LoadLocal, location.slot_);
+            break;
+        case Location::Kind::Capture:
+            Emit(location.boxed_ ? OpCode::LoadCaptureBoxed : OpCode::LoadCapture, location.slot_);
+            break;
+        case Location::Kind::Global:
+            Emit(OpCode::LoadGlobal, AddGlobal(location.symbol_));
+            break;
+    }
+}
+
+void Compiler::EmitStore(const Location& location) {
+    switch (location.kind_) {
+        case Location::Kind::Local:
+            Emit(location.boxed_ ? OpCode::StoreBoxed : OpCode::StoreLocal, location.slot_);
+            break;
+        case Location::Kind::Capture:
+            throw std::logic_error("captured variables are not assigned");
+        case Location::Kind::Global:
+            throw std::logic_error("globals are bound with def!");
+    }
+}
+
+void Compiler::DeclareParams(const std::vector<InternId>& binds, const MalNode& body) {
+    blocks_.push_back(Block{});
+    chunk_->binds_ = binds;
+    chunk_->body_ = body;
+
+    for (std::size_t index = 0; index < binds.size(); index++) {
+        if (binds[index] == SpecialForm::Variadic) {
+            if (index + 1 >= binds.size())
+                throw std::logic_error("& must be followed by a parameter!");
+
+            chunk_->variadic_ = true;
+            chunk_->arity_ = CheckOperand(index, "parameters");
+            Declare(binds[index + 1]);
+            Settle(binds[index + 1]);
+            return;
+        }
+
+        Declare(binds[index]);
+        Settle(binds[index]);
+    }
+
+    chunk_->arity_ = CheckOperand(binds.size(), "parameters");
+}
+
+std::string Compiler::TakeFunctionName() {
+    auto name = function_name_.empty() ? std::string{"fn*"} : std::move(function_name_);
+    function_name_.clear();
+
+    return name;
+}
+
+std::shared_ptr<const Chunk> Compiler::Finish() {
+    Emit(OpCode::Return);
+
+    chunk_->max_stack_ = CheckOperand(max_depth_, "operands");
+
+    return chunk_;
+}
+
+void Constant::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    switch (value_.Type()) {
+        case MalType::NodeType::Nil:
+            compiler.Emit(OpCode::Nil);
+            break;
+        case MalType::NodeType::Boolean:
+            compiler.Emit(value_.AsBool() ? OpCode::True : OpCode::False);
+            break;
+        default:
+            compiler.Emit(OpCode::Constant, compiler.AddConstant(value_));
+            break;
+    }
+}
+
+void Lookup::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    compiler.EmitLoad(compiler.Resolve(symbol_));
+}
+
+void Define::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    compiler.SetFunctionName(InternTable::Instance().Name(symbol_));
+
+    if (!compiler.InLocalScope()) {
+        value_->Compile(compiler, false);
+        compiler.TakeFunctionName();
+        compiler.Emit(OpCode::DefineGlobal, compiler.AddGlobal(symbol_));
+        return;
+    }
+
+    // def! in a local scope binds in the innermost let* or function body. The binding is
+    // declared first so a closure in the value can refer to itself, and looked up again
+    // after, as compiling the value can box it.
+    compiler.Declare(symbol_, true);
+    value_->Compile(compiler, false);
+    compiler.TakeFunctionName();
+
+    auto location = compiler.Declare(symbol_, true);
+    compiler.EmitStore(location);
+    compiler.Settle(symbol_);
+    compiler.EmitLoad(location);
+}
+
+void Let::Compile(Compiler& compiler, bool tail) const {
+    compiler.BeginBlock();
+
+    for (auto& [symbol, value] : bindings_) {
+        // A name bound twice in one let* is assigned twice
+        auto bound = std::ranges::count_if(bindings_, [&](auto& binding) { return binding.first == symbol; });
+        compiler.Declare(symbol, bound > 1);
+    }
+    for (auto symbol : defines_)
+        compiler.Declare(symbol, true);
+
+    for (auto& [symbol, value] : bindings_) {
+        value->Compile(compiler, false);
+        compiler.EmitStore(compiler.Declare(symbol));
+        compiler.Settle(symbol);
+    }
+
+    body_->Compile(compiler, tail);
+    compiler.EndBlock();
+}
+
+void Do::Compile(Compiler& compiler, bool tail) const {
+    for (std::size_t i = 0; i + 1 < forms_.size(); i++) {
+        forms_[i]->Compile(compiler, false);
+        compiler.Emit(OpCode::Pop);
+    }
+
+    forms_.back()->Compile(compiler, tail);
+}
+
+void If::Compile(Compiler& compiler, bool tail) const {
+    condition_->Compile(compiler, false);
+    auto to_otherwise = compiler.EmitJump(OpCode::JumpIfFalse);
+    auto depth = compiler.Depth();
+
+    then_->Compile(compiler, tail);
+    auto to_end = compiler.EmitJump(OpCode::Jump);
+
+    compiler.SetDepth(depth);
+    compiler.PatchJump(to_otherwise);
+    otherwise_->Compile(compiler, tail);
+    compiler.PatchJump(to_end);
+}
+
+void Lambda::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    Compiler body_compiler {compiler.TakeFunctionName(), &compiler};
+
+    body_compiler.DeclareParams(binds_, source_);
+    for (auto symbol : defines_)
+        body_compiler.Declare(symbol, true);
+    body_->Compile(body_compiler, true);
+
+    compiler.Emit(OpCode::Closure, compiler.AddFunction(body_compiler.Finish()));
+}
+
+void Call::Compile(Compiler& compiler, bool tail) const {
+    callee_->Compile(compiler, false);
+    for (auto& arg : args_)
+        arg->Compile(compiler, false);
+
+    compiler.Emit(tail ? OpCode::TailCall : OpCode::Call, static_cast<std::uint16_t>(args_.size()));
+}
+
+void VectorLiteral::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    for (auto& element : elements_)
+        element->Compile(compiler, false);
+
+    compiler.Emit(OpCode::MakeVector, static_cast<std::uint16_t>(elements_.size()));
+}
+
+void HashMapLiteral::Compile(Compiler& compiler, [[maybe_unused]] bool tail) const {
+    for (auto& [key, value] : entries_) {
+        key->Compile(compiler, false);
+        value->Compile(compiler, false);
+    }
+
+    compiler.Emit(OpCode::MakeHashMap, static_cast<std::uint16_t>(entries_.size()));
+}
+
+std::shared_ptr<const Chunk> Compile(const MalNode& form) {
+    Scope scope {};
+    auto code = Analyze(form, scope);
+
+    Compiler compiler {"toplevel"};
+    code->Compile(compiler, true);
+
+    return compiler.Finish();
+}
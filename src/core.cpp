@@ -1,204 +1,713 @@
+#include "../include/arena.h"
 #include "../include/core.h"
+#include "../include/numarray.h"
+#include "../include/numeric.h"
+#include "../include/printer.h"
+#include "../include/vm.h"
 
-auto plus =  std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto int_node = std::make_shared<Int>(0);
-    for (auto& node : nodes)
-        int_node->num_ += static_cast<Int*>(node.get())->num_;
-    return int_node;
+namespace {
+
+/*
+ * @brief A non-negative integer argument, as an index
+ * */
+std::size_t IndexArg(const MalNode& node) {
+    if (node.Type() != MalType::NodeType::Int || node.AsInt() < 0)
+        throw std::logic_error("index must be a non-negative integer!");
+
+    return static_cast<std::size_t>(node.AsInt());
+}
+
+/*
+ * @brief A count argument of take or drop, as at least 0
+ * */
+std::int64_t CountArg(const MalNode& node) {
+    if (node.Type() != MalType::NodeType::Int)
+        throw std::logic_error("count must be an integer!");
+
+    return std::max<std::int64_t>(node.AsInt(), 0);
+}
+
+/*
+ * @brief Checks that the first argument of a conj!, assoc!, dissoc! or persistent! is a
+ * transient of one of the given types, i.e. that it has not been made persistent yet
+ * */
+void CheckTransient(const std::vector<MalNode>& nodes, bool vectors, const std::string& name) {
+    if (!nodes.empty() && nodes[0].Type() == MalType::NodeType::Vector && vectors) {
+        if (!nodes[0].template As<Vector>()->IsTransient())
+            throw std::logic_error(name + " takes a transient, not one made persistent!");
+        return;
+    }
+    if (!nodes.empty() && nodes[0].Type() == MalType::NodeType::HashMap) {
+        if (!nodes[0].template As<HashMap>()->IsTransient())
+            throw std::logic_error(name + " takes a transient, not one made persistent!");
+        return;
+    }
+
+    throw std::logic_error(name + (vectors ? " takes a transient vector or hash-map!" : " takes a transient hash-map!"));
+}
+
+/*
+ * @brief The least or greatest of the numbers in nodes, or of the elements of one array
+ * */
+MalNode Extreme(std::vector<MalNode>& nodes, bool max) {
+    if (nodes.size() == 1 && IsArray(nodes[0]))
+        return ArrayReduce(max ? ArrayReduceOp::Max : ArrayReduceOp::Min, nodes[0]);
+
+    auto extreme = nodes[0];
+    for (auto& node : nodes) {
+        auto order = CompareNumbers(node, extreme);
+        if (max ? order > 0 : order < 0)
+            extreme = node;
+    }
+    return extreme;
+}
+
+} // namespace
+
+auto plus = MalNode::Make<Builtin>("+", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    // Starting from the first argument rather than 0 saves a copy when it is an array
+    if (nodes.size() < 2)
+        return AddNumbers(MalNode::Int(0), nodes.empty() ? MalNode::Int(0) : nodes[0]);
+
+    auto sum = nodes[0];
+    for (auto& node : nodes | std::views::drop(1))
+        sum = AddNumbers(sum, node);
+    return sum;
 });
 
-auto subtract = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto first_node_val = static_cast<Int*>(nodes[0].get())->num_;
-    auto int_node = std::make_shared<Int>(first_node_val);
+auto subtract = MalNode::Make<Builtin>("-", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    auto difference = nodes[0];
     for (auto& node : nodes | std::views::drop(1))
-        int_node->num_ -= static_cast<Int*>(node.get())->num_;
-    return int_node;
+        difference = SubtractNumbers(difference, node);
+    return difference;
 });
 
-auto multiply = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto int_node = std::make_shared<Int>(1);
-    for (auto& node : nodes)
-        int_node->num_ *= static_cast<Int*>(node.get())->num_;
-    return int_node;
+auto multiply = MalNode::Make<Builtin>("*", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    if (nodes.size() < 2)
+        return MultiplyNumbers(MalNode::Int(1), nodes.empty() ? MalNode::Int(1) : nodes[0]);
+
+    auto product = nodes[0];
+    for (auto& node : nodes | std::views::drop(1))
+        product = MultiplyNumbers(product, node);
+    return product;
 });
 
-auto divide = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto first_node_val = static_cast<Int*>(nodes[0].get())->num_;
-    auto int_node = std::make_shared<Int>(first_node_val);
+auto divide = MalNode::Make<Builtin>("/", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    auto quotient = nodes[0];
     for (auto& node : nodes | std::views::drop(1))
-        int_node->num_ /= static_cast<Int*>(node.get())->num_;
-    return int_node;
+        quotient = DivideNumbers(quotient, node);
+    return quotient;
 });
 
-auto list = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto list_node = std::make_shared<List>();
-    list_node->children_ = nodes;
+auto list = MalNode::Make<Builtin>("list", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    auto list_node = MalNode::Make<List>();
+    list_node.As<List>()->children_ = nodes;
 
     return list_node;
 });
 
-auto is_list = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto list_node = dynamic_cast<List*>(nodes[0].get());
-
-    return std::make_shared<Boolean>(list_node != nullptr);
-
+auto is_list = MalNode::Make<Builtin>("list?", 1, 1, [](auto& nodes) -> MalNode {
+    return MalNode::Boolean(nodes[0].Type() == MalType::NodeType::List);
 });
 
-auto is_empty =  std::make_shared<Function>([](auto& nodes) -> MalNode {
+auto is_empty = MalNode::Make<Builtin>("empty?", 1, 1, [](auto& nodes) -> MalNode {
     std::size_t size = 0;
-    switch (nodes[0]->type_) {
+    switch (nodes[0].Type()) {
         case MalType::NodeType::List:
-            size = static_cast<List*>(nodes[0].get())->children_.size();
+            size = nodes[0].template As<List>()->children_.size();
             break;
         case MalType::NodeType::Vector:
-            size = static_cast<Vector*>(nodes[0].get())->children_.size();
+            size = nodes[0].template As<Vector>()->Size();
+            break;
+        case MalType::NodeType::HashMap:
+            size = nodes[0].template As<HashMap>()->Size();
+            break;
+        case MalType::NodeType::LazySeq:
+            return MalNode::Boolean(SeqCursor{nodes[0]}.Done());
+        case MalType::NodeType::F64Array:
+            size = nodes[0].template As<F64Array>()->Size();
+            break;
+        case MalType::NodeType::I64Array:
+            size = nodes[0].template As<I64Array>()->Size();
             break;
         default:
             throw std::logic_error("First parameter must be a list or a vector!");
     }
 
-    return std::make_shared<Boolean>(size == 0);
+    return MalNode::Boolean(size == 0);
 });
 
-auto count = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    auto size = 0;
-    switch (nodes[0]->type_) {
+auto count = MalNode::Make<Builtin>("count", 1, 1, [](auto& nodes) -> MalNode {
+    std::int64_t size = 0;
+    switch (nodes[0].Type()) {
         case MalType::NodeType::Nil:
             size = 0;
             break;
         case MalType::NodeType::Vector:
-            size = static_cast<Vector*>(nodes[0].get())->children_.size();
+            size = nodes[0].template As<Vector>()->Size();
             break;
         case MalType::NodeType::List:
-            size = static_cast<List*>(nodes[0].get())->children_.size();
+            size = nodes[0].template As<List>()->children_.size();
+            break;
+        case MalType::NodeType::HashMap:
+            size = nodes[0].template As<HashMap>()->Size();
+            break;
+        case MalType::NodeType::LazySeq: {
+            // The cursor takes the only reference, so the chunks it has counted are freed
+            for (SeqCursor cursor {std::move(nodes[0])}; !cursor.Done(); cursor.Next())
+                size++;
+            break;
+        }
+        case MalType::NodeType::F64Array:
+            size = nodes[0].template As<F64Array>()->Size();
+            break;
+        case MalType::NodeType::I64Array:
+            size = nodes[0].template As<I64Array>()->Size();
             break;
         default:
             throw std::logic_error("count not found!");
     }
-    return std::make_shared<Int>(size);
+    return MalNode::Int(size);
 });
 
-auto less =  std::make_shared<Function>([](auto& nodes) -> MalNode {
-    if (nodes.size() != 2)
-        throw std::logic_error("< is a binary operator!");
+auto nth = MalNode::Make<Builtin>("nth", 2, 2, [](auto& nodes) -> MalNode {
+    auto index = IndexArg(nodes[1]);
+    switch (nodes[0].Type()) {
+        case MalType::NodeType::List: {
+            auto& children = nodes[0].template As<List>()->children_;
+            if (index >= children.size())
+                throw std::logic_error("index out of bounds!");
+            return children[index];
+        }
+        case MalType::NodeType::Vector: {
+            auto vector = nodes[0].template As<Vector>();
+            if (index >= vector->Size())
+                throw std::logic_error("index out of bounds!");
+            return vector->Nth(index);
+        }
+        case MalType::NodeType::LazySeq: {
+            SeqCursor cursor {nodes[0], index};
+            if (cursor.Done())
+                throw std::logic_error("index out of bounds!");
+            return cursor.Get();
+        }
+        case MalType::NodeType::F64Array:
+        case MalType::NodeType::I64Array:
+            return ArrayNth(nodes[0], index);
+        default:
+            throw std::logic_error("nth takes a list or a vector!");
+    }
+});
 
-    auto num1 = (nodes[0]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[0].get())->num_ : static_cast<Int*>(nodes[0].get())->num_;
-    auto num2 = (nodes[1]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[1].get())->num_ : static_cast<Int*>(nodes[1].get())->num_;
+auto first = MalNode::Make<Builtin>("first", 1, 1, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[0]))
+        throw std::logic_error("first takes a sequence!");
 
-    return std::make_shared<Boolean>(num1 < num2);
+    SeqCursor cursor {nodes[0]};
+    return cursor.Done() ? MalNode::Nil() : cursor.Get();
 });
 
-auto leq = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    if (nodes.size() != 2)
-        throw std::logic_error("<= is a binary operator!");
+auto rest = MalNode::Make<Builtin>("rest", 1, 1, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[0]))
+        throw std::logic_error("rest takes a sequence!");
+
+    // Lazy seqs stay lazy, lists and vectors give a list as in MAL
+    if (nodes[0].Type() == MalType::NodeType::LazySeq) {
+        SeqCursor cursor {nodes[0]};
+        if (!cursor.Done())
+            cursor.Next();
+        return cursor.Done() ? MalNode::Make<List>() : cursor.Rest();
+    }
 
-    auto num1 = (nodes[0]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[0].get())->num_ : static_cast<Int*>(nodes[0].get())->num_;
-    auto num2 = (nodes[1]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[1].get())->num_ : static_cast<Int*>(nodes[1].get())->num_;
+    auto list_node = MalNode::Make<List>();
+    SeqCursor cursor {nodes[0], 1};
+    for (; !cursor.Done(); cursor.Next())
+        list_node.template As<List>()->children_.push_back(cursor.Get());
 
-    return std::make_shared<Boolean>(num1 <= num2);
+    return list_node;
 });
 
-auto greater = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    if (nodes.size() != 2)
-        throw std::logic_error("> is a binary operator!");
+auto cons = MalNode::Make<Builtin>("cons", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[1]))
+        throw std::logic_error("cons takes a value and a sequence!");
 
-    auto num1 = (nodes[0]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[0].get())->num_ : static_cast<Int*>(nodes[0].get())->num_;
-    auto num2 = (nodes[1]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[1].get())->num_ : static_cast<Int*>(nodes[1].get())->num_;
+    return LazySeq::Cons(nodes[0], nodes[1]);
+});
 
-    return std::make_shared<Boolean>(num1 > num2);
+auto range = MalNode::Make<Builtin>("range", 0, 3, [](auto& nodes) -> MalNode {
+    for (auto& node : nodes) {
+        if (node.Type() != MalType::NodeType::Int)
+            throw std::logic_error("range takes integers!");
+    }
 
+    switch (nodes.size()) {
+        case 0:
+            return LazySeq::Range(MalNode::Int(0), -1, 1);
+        case 1:
+            return LazySeq::Range(MalNode::Int(0), std::max<std::int64_t>(nodes[0].AsInt(), 0), 1);
+        default: {
+            auto start = nodes[0].AsInt();
+            auto end = nodes[1].AsInt();
+            auto step = (nodes.size() == 3) ? nodes[2].AsInt() : 1;
+
+            // In 128 bits, where neither end - start nor -step can overflow. A count past
+            // INT64_MAX is clamped to it, as no range is ever realized that far
+            __int128 count = 0;
+            if (step > 0 && end > start)
+                count = (static_cast<__int128>(end) - start - 1) / step + 1;
+            else if (step < 0 && end < start)
+                count = (static_cast<__int128>(start) - end - 1) / -static_cast<__int128>(step) + 1;
+            else if (step == 0 && end != start)
+                count = -1;
+
+            count = std::min<__int128>(count, std::numeric_limits<std::int64_t>::max());
+            return LazySeq::Range(MalNode::Int(start), static_cast<std::int64_t>(count), step);
+        }
+    }
 });
 
-auto geq = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    if (nodes.size() != 2)
-        throw std::logic_error(">= is a binary operator!");
+auto iterate = MalNode::Make<Builtin>("iterate", 2, 2, [](auto& nodes) -> MalNode {
+    return LazySeq::Iterate(nodes[0], nodes[1]);
+});
 
-    auto num1 = (nodes[0]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[0].get())->num_ : static_cast<Int*>(nodes[0].get())->num_;
-    auto num2 = (nodes[1]->type_ == MalType::NodeType::Double)? static_cast<Double*>(nodes[1].get())->num_ : static_cast<Int*>(nodes[1].get())->num_;
+auto take = MalNode::Make<Builtin>("take", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[1]))
+        throw std::logic_error("take takes a count and a sequence!");
 
-    return std::make_shared<Boolean>(num1 >= num2);
+    return LazySeq::Take(CountArg(nodes[0]), nodes[1]);
 });
 
-auto equal = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    if (nodes.size() != 2)
-        throw std::logic_error(">= is a binary operator!");
+auto drop = MalNode::Make<Builtin>("drop", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[1]))
+        throw std::logic_error("drop takes a count and a sequence!");
 
-    auto equal = (*nodes[0] == *nodes[1]);
+    return LazySeq::Drop(CountArg(nodes[0]), nodes[1]);
+});
+
+auto map = MalNode::Make<Builtin>("map", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[1]))
+        throw std::logic_error("map takes a function and a sequence!");
 
-    return std::make_shared<Boolean>(equal);
+    return LazySeq::Map(nodes[0], nodes[1]);
 });
 
-auto prn =  std::make_shared<Function>([](auto& nodes) -> MalNode {
-    for (std::size_t index = 0; auto& node : nodes) {
-        std::cout << node->Print(true);
+auto filter = MalNode::Make<Builtin>("filter", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsSeq(nodes[1]))
+        throw std::logic_error("filter takes a function and a sequence!");
 
-        if (nodes.size() > 1 && index < nodes.size() - 1)
-            std::cout << " ";
+    return LazySeq::Filter(nodes[0], nodes[1]);
+});
 
-        index++;
+auto conjoin = MalNode::Make<Builtin>("conj", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    switch (nodes[0].Type()) {
+        case MalType::NodeType::Nil:
+        case MalType::NodeType::List: {
+            // Lists grow at the front
+            auto list_node = MalNode::Make<List>();
+            auto& children = list_node.template As<List>()->children_;
+            for (auto& node : nodes | std::views::drop(1) | std::views::reverse)
+                children.push_back(node);
+            if (nodes[0].Type() == MalType::NodeType::List)
+                std::ranges::copy(nodes[0].template As<List>()->children_, std::back_inserter(children));
+
+            return list_node;
+        }
+        case MalType::NodeType::Vector: {
+            auto result = nodes[0];
+            for (auto& node : nodes | std::views::drop(1))
+                result = result.template As<Vector>()->Conj(node);
+
+            return result;
+        }
+        default:
+            throw std::logic_error("conj takes a list or a vector!");
     }
-    std::cout << "\n";
+});
+
+auto assoc = MalNode::Make<Builtin>("assoc", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    if (nodes.size() % 2 != 1)
+        throw std::logic_error("assoc takes a collection and key/value pairs!");
+
+    switch (nodes[0].Type()) {
+        case MalType::NodeType::Vector: {
+            auto result = nodes[0];
+            for (std::size_t index = 1; index < nodes.size(); index += 2)
+                result = result.template As<Vector>()->Assoc(IndexArg(nodes[index]), nodes[index + 1]);
+
+            return result;
+        }
+        case MalType::NodeType::HashMap: {
+            auto result = nodes[0];
+            for (std::size_t index = 1; index < nodes.size(); index += 2)
+                result = result.template As<HashMap>()->Assoc(nodes[index], nodes[index + 1]);
+
+            return result;
+        }
+        default:
+            throw std::logic_error("assoc takes a vector or a hash-map!");
+    }
+});
+
+auto hash_map = MalNode::Make<Builtin>("hash-map", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    if (nodes.size() % 2 != 0)
+        throw std::logic_error("hash-map takes key/value pairs!");
+
+    auto hash_map_node = MalNode::Make<HashMap>();
+    for (std::size_t index = 0; index < nodes.size(); index += 2)
+        hash_map_node.template As<HashMap>()->Add(nodes[index], nodes[index + 1]);
+
+    return hash_map_node;
+});
 
-    return std::make_shared<Nil>();
+auto dissoc = MalNode::Make<Builtin>("dissoc", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::HashMap)
+        throw std::logic_error("dissoc takes a hash-map and keys!");
+
+    auto result = nodes[0];
+    for (auto& key : nodes | std::views::drop(1))
+        result = result.template As<HashMap>()->Dissoc(key);
+
+    return result;
+});
+
+auto get = MalNode::Make<Builtin>("get", 2, 2, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() == MalType::NodeType::Nil)
+        return MalNode::Nil();
+    if (nodes[0].Type() != MalType::NodeType::HashMap)
+        throw std::logic_error("get takes a hash-map!");
+
+    auto value = nodes[0].template As<HashMap>()->Find(nodes[1]);
+    return value != nullptr ? *value : MalNode::Nil();
+});
+
+auto contains = MalNode::Make<Builtin>("contains?", 2, 2, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::HashMap)
+        throw std::logic_error("contains? takes a hash-map and a key!");
+
+    return MalNode::Boolean(nodes[0].template As<HashMap>()->Find(nodes[1]) != nullptr);
+});
+
+auto keys = MalNode::Make<Builtin>("keys", 1, 1, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::HashMap)
+        throw std::logic_error("keys takes a hash-map!");
+
+    auto list_node = MalNode::Make<List>();
+    nodes[0].template As<HashMap>()->ForEach([&](const MalNode& key, [[maybe_unused]] const MalNode& value) {
+        list_node.template As<List>()->Add(key);
+    });
+
+    return list_node;
+});
+
+auto vals = MalNode::Make<Builtin>("vals", 1, 1, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::HashMap)
+        throw std::logic_error("vals takes a hash-map!");
+
+    auto list_node = MalNode::Make<List>();
+    nodes[0].template As<HashMap>()->ForEach([&]([[maybe_unused]] const MalNode& key, const MalNode& value) {
+        list_node.template As<List>()->Add(value);
+    });
+
+    return list_node;
 });
 
-auto pr_str = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    std::stringstream ss;
-    for (std::size_t index = 0; auto& node : nodes) {
-        ss << node->Print(true);
+auto subvec = MalNode::Make<Builtin>("subvec", 2, 3, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::Vector)
+        throw std::logic_error("subvec takes a vector, a start and an optional end!");
 
-        if (nodes.size() > 1 && index < nodes.size() - 1)
-            ss << " ";
+    auto vector = nodes[0].template As<Vector>();
+    auto end = (nodes.size() == 3) ? IndexArg(nodes[2]) : vector->Size();
 
-        index++;
+    return vector->Subvec(IndexArg(nodes[1]), end);
+});
+
+auto transient = MalNode::Make<Builtin>("transient", 1, 1, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() == MalType::NodeType::Vector)
+        return nodes[0].template As<Vector>()->Transient();
+    if (nodes[0].Type() == MalType::NodeType::HashMap)
+        return nodes[0].template As<HashMap>()->Transient();
+
+    throw std::logic_error("transient takes a vector or a hash-map!");
+});
+
+auto conj_transient = MalNode::Make<Builtin>("conj!", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    CheckTransient(nodes, true, "conj!");
+
+    if (nodes[0].Type() == MalType::NodeType::Vector) {
+        for (auto& node : nodes | std::views::drop(1))
+            nodes[0].template As<Vector>()->Add(node);
+        return nodes[0];
     }
-    return std::make_shared<String>(ss.str());
+
+    // A map is conjoined [key value] pairs
+    for (auto& node : nodes | std::views::drop(1)) {
+        if (node.Type() != MalType::NodeType::Vector || node.template As<Vector>()->Size() != 2)
+            throw std::logic_error("conj! on a hash-map takes [key value] pairs!");
+
+        auto pair = node.template As<Vector>();
+        nodes[0].template As<HashMap>()->Add(pair->Nth(0), pair->Nth(1));
+    }
+    return nodes[0];
 });
 
-auto str = std::make_shared<Function>([](auto& nodes) -> MalNode {
-    std::stringstream ss;
-    for (auto& node : nodes) {
-        auto printed_value = node->Print(false);
-        ss << printed_value;
+auto assoc_transient = MalNode::Make<Builtin>("assoc!", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    CheckTransient(nodes, true, "assoc!");
+    if (nodes.size() % 2 != 1)
+        throw std::logic_error("assoc! takes a transient and key/value pairs!");
+
+    for (std::size_t index = 1; index < nodes.size(); index += 2) {
+        if (nodes[0].Type() == MalType::NodeType::Vector)
+            nodes[0].template As<Vector>()->Replace(IndexArg(nodes[index]), nodes[index + 1]);
+        else
+            nodes[0].template As<HashMap>()->Add(nodes[index], nodes[index + 1]);
     }
-    return std::make_shared<String>(ss.str());
+
+    return nodes[0];
+});
+
+auto dissoc_transient = MalNode::Make<Builtin>("dissoc!", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    CheckTransient(nodes, false, "dissoc!");
+
+    for (auto& key : nodes | std::views::drop(1))
+        nodes[0].template As<HashMap>()->Remove(key);
+
+    return nodes[0];
+});
+
+auto persistent = MalNode::Make<Builtin>("persistent!", 1, 1, [](auto& nodes) -> MalNode {
+    CheckTransient(nodes, true, "persistent!");
+    if (nodes[0].Type() == MalType::NodeType::Vector)
+        nodes[0].template As<Vector>()->Persist();
+    else
+        nodes[0].template As<HashMap>()->Persist();
+
+    return nodes[0];
 });
 
-auto println =  std::make_shared<Function>([](auto& nodes) -> MalNode {
-    std::stringstream ss;
-    for (std::size_t index = 0; auto& node : nodes) {
-        auto printed_value = node->Print(false);
-        std::cout << printed_value;
+auto less = MalNode::Make<Builtin>("<", 2, 2, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]) || IsArray(nodes[1]))
+        return ArrayCompare(ArrayCompareOp::Less, nodes[0], nodes[1]);
 
-        if (index != nodes.size() - 1)
-            std::cout << " ";
+    return MalNode::Boolean(CompareNumbers(nodes[0], nodes[1]) < 0);
+});
+
+auto leq = MalNode::Make<Builtin>("<=", 2, 2, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]) || IsArray(nodes[1]))
+        return ArrayCompare(ArrayCompareOp::LessEqual, nodes[0], nodes[1]);
+
+    return MalNode::Boolean(CompareNumbers(nodes[0], nodes[1]) <= 0);
+});
+
+auto greater = MalNode::Make<Builtin>(">", 2, 2, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]) || IsArray(nodes[1]))
+        return ArrayCompare(ArrayCompareOp::Greater, nodes[0], nodes[1]);
+
+    return MalNode::Boolean(CompareNumbers(nodes[0], nodes[1]) > 0);
+});
+
+auto geq = MalNode::Make<Builtin>(">=", 2, 2, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]) || IsArray(nodes[1]))
+        return ArrayCompare(ArrayCompareOp::GreaterEqual, nodes[0], nodes[1]);
+
+    return MalNode::Boolean(CompareNumbers(nodes[0], nodes[1]) >= 0);
+});
+
+auto equal = MalNode::Make<Builtin>("=", 2, 2, [](auto& nodes) -> MalNode {
+    auto equal = (nodes[0] == nodes[1]);
+
+    return MalNode::Boolean(equal);
+});
+
+auto array_equal = MalNode::Make<Builtin>("array=", 2, 2, [](auto& nodes) -> MalNode {
+    if (!IsArray(nodes[0]) && !IsArray(nodes[1]))
+        throw std::logic_error("array= compares an array with an array or a number!");
+
+    return ArrayCompare(ArrayCompareOp::Equal, nodes[0], nodes[1]);
+});
+
+auto f64_array = MalNode::Make<Builtin>("f64-array", 1, 1, [](auto& nodes) -> MalNode {
+    return MakeF64Array(nodes[0]);
+});
 
-        index++;
+auto i64_array = MalNode::Make<Builtin>("i64-array", 1, 1, [](auto& nodes) -> MalNode {
+    return MakeI64Array(nodes[0]);
+});
+
+auto vec = MalNode::Make<Builtin>("vec", 1, 1, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]))
+        return ArrayToVector(nodes[0]);
+    if (nodes[0].Type() == MalType::NodeType::Vector)
+        return nodes[0];
+    if (!IsSeq(nodes[0]))
+        throw std::logic_error("vec takes a seq or an array!");
+
+    auto vector = MalNode::Make<Vector>();
+    for (SeqCursor cursor {nodes[0]}; !cursor.Done(); cursor.Next())
+        vector.template As<Vector>()->Add(cursor.Get());
+    return vector;
+});
+
+auto sum = MalNode::Make<Builtin>("sum", 1, 1, [](auto& nodes) -> MalNode {
+    if (IsArray(nodes[0]))
+        return ArrayReduce(ArrayReduceOp::Sum, nodes[0]);
+    if (!IsSeq(nodes[0]))
+        throw std::logic_error("sum takes a seq of numbers or an array!");
+
+    auto total = MalNode::Int(0);
+    for (SeqCursor cursor {nodes[0]}; !cursor.Done(); cursor.Next())
+        total = AddNumbers(total, cursor.Get());
+    return total;
+});
+
+auto min = MalNode::Make<Builtin>("min", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    return Extreme(nodes, false);
+});
+
+auto max = MalNode::Make<Builtin>("max", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+    return Extreme(nodes, true);
+});
+
+auto dot = MalNode::Make<Builtin>("dot", 2, 2, [](auto& nodes) -> MalNode {
+    return ArrayDot(nodes[0], nodes[1]);
+});
+
+auto prn = MalNode::Make<Builtin>("prn", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    PrintLine(nodes, true);
+
+    return MalNode::Nil();
+});
+
+auto pr_str = MalNode::Make<Builtin>("pr-str", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    std::string out;
+    PrintNodes(nodes, out, true, true);
+
+    return MalNode::Make<String>(std::move(out));
+});
+
+auto str = MalNode::Make<Builtin>("str", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    // Long strings are concatenated as ropes and shared, everything else is printed
+    // into out and joined on as one piece
+    MalNode result = MalNode::Make<String>(std::string{});
+    std::string out;
+    for (auto& node : nodes) {
+        if (node.Type() != MalType::NodeType::String || node.template As<String>()->Size() <= String::leaf_size) {
+            node.PrintTo(out, false);
+            continue;
+        }
+
+        if (!out.empty())
+            result = String::Concat(result, MalNode::Make<String>(std::move(out)));
+        result = String::Concat(result, node);
+        out.clear();
     }
-    std::cout << "\n";
-    return std::make_shared<Nil>();
+
+    if (!out.empty())
+        result = String::Concat(result, MalNode::Make<String>(std::move(out)));
+    return result;
+});
+
+auto subs = MalNode::Make<Builtin>("subs", 2, 3, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::String)
+        throw std::logic_error("subs takes a string, a start and an optional end!");
+
+    auto string = nodes[0].template As<String>();
+    auto start = IndexArg(nodes[1]);
+    auto end = (nodes.size() == 3) ? IndexArg(nodes[2]) : string->Size();
+    if (start > end || end > string->Size())
+        throw std::logic_error("index out of bounds!");
+
+    return string->Substring(start, end);
+});
+
+auto println = MalNode::Make<Builtin>("println", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+    PrintLine(nodes, false);
+
+    return MalNode::Nil();
+});
+
+auto gc_stats = MalNode::Make<Builtin>("gc-stats", 0, 0, []([[maybe_unused]] auto& nodes) -> MalNode {
+    auto stats = Gc::Instance().Stats();
+
+    auto stats_node = MalNode::Make<HashMap>();
+    auto stats_map = stats_node.template As<HashMap>();
+    stats_map->Add(MalNode::Keyword(Intern("collections")), MalNode::Int(stats.collections));
+    stats_map->Add(MalNode::Keyword(Intern("tracked")), MalNode::Int(stats.tracked));
+    stats_map->Add(MalNode::Keyword(Intern("collected")), MalNode::Int(stats.collected));
+    stats_map->Add(MalNode::Keyword(Intern("threshold")), MalNode::Int(stats.threshold));
+    stats_map->Add(MalNode::Keyword(Intern("allocated")), MalNode::Int(stats.allocated));
+    stats_map->Add(MalNode::Keyword(Intern("live")), MalNode::Int(stats.live));
+    stats_map->Add(MalNode::Keyword(Intern("reserved")), MalNode::Int(static_cast<std::int64_t>(Arena::Instance().Reserved())));
+
+    return stats_node;
+});
+
+auto disassemble = MalNode::Make<Builtin>("disassemble", 1, 1, [](auto& nodes) -> MalNode {
+    if (nodes[0].Type() != MalType::NodeType::Closure)
+        throw std::logic_error("disassemble takes a function!");
+
+    auto func = nodes[0].template As<Closure>();
+    if (!func->chunk_)
+        throw std::logic_error("function has no bytecode!");
+
+    std::cout << Disassemble(*func->chunk_);
+    return MalNode::Nil();
 });
 
 Core::Core() {
-    core_env_["+"] = plus;
-    core_env_["-"] = subtract;
-    core_env_["*"] = multiply;
-    core_env_["/"] = divide;
-    core_env_["list"] = list;
-    core_env_["list?"] = is_list;
-    core_env_["empty?"] = is_empty;
-    core_env_["count"] = count;
-    core_env_["<"] = less;
-    core_env_["<="] = leq;
-    core_env_[">"] = greater;
-    core_env_[">="] = geq;
-    core_env_["="] = equal;
-    core_env_["prn"] = prn;
-    core_env_["pr-str"] = pr_str;
-    core_env_["str"] = str;
-    core_env_["println"] = println;
+    core_env_[Intern("+")] = plus;
+    core_env_[Intern("-")] = subtract;
+    core_env_[Intern("*")] = multiply;
+    core_env_[Intern("/")] = divide;
+    core_env_[Intern("list")] = list;
+    core_env_[Intern("list?")] = is_list;
+    core_env_[Intern("empty?")] = is_empty;
+    core_env_[Intern("count")] = count;
+    core_env_[Intern("nth")] = nth;
+    core_env_[Intern("first")] = first;
+    core_env_[Intern("rest")] = rest;
+    core_env_[Intern("cons")] = cons;
+    core_env_[Intern("range")] = range;
+    core_env_[Intern("iterate")] = iterate;
+    core_env_[Intern("take")] = take;
+    core_env_[Intern("drop")] = drop;
+    core_env_[Intern("map")] = map;
+    core_env_[Intern("filter")] = filter;
+    core_env_[Intern("conj")] = conjoin;
+    core_env_[Intern("assoc")] = assoc;
+    core_env_[Intern("subvec")] = subvec;
+    core_env_[Intern("hash-map")] = hash_map;
+    core_env_[Intern("dissoc")] = dissoc;
+    core_env_[Intern("get")] = get;
+    core_env_[Intern("contains?")] = contains;
+    core_env_[Intern("keys")] = keys;
+    core_env_[Intern("vals")] = vals;
+    core_env_[Intern("transient")] = transient;
+    core_env_[Intern("conj!")] = conj_transient;
+    core_env_[Intern("assoc!")] = assoc_transient;
+    core_env_[Intern("dissoc!")] = dissoc_transient;
+    core_env_[Intern("persistent!")] = persistent;
+    core_env_[Intern("<")] = less;
+    core_env_[Intern("<=")] = leq;
+    core_env_[Intern(">")] = greater;
+    core_env_[Intern(">=")] = geq;
+    core_env_[Intern("=")] = equal;
+    core_env_[Intern("array=")] = array_equal;
+    core_env_[Intern("f64-array")] = f64_array;
+    core_env_[Intern("i64-array")] = i64_array;
+    core_env_[Intern("vec")] = vec;
+    core_env_[Intern("sum")] = sum;
+    core_env_[Intern("min")] = min;
+    core_env_[Intern("max")] = max;
+    core_env_[Intern("dot")] = dot;
+    core_env_[Intern("prn")] = prn;
+    core_env_[Intern("pr-str")] = pr_str;
+    core_env_[Intern("str")] = str;
+    core_env_[Intern("subs")] = subs;
+    core_env_[Intern("println")] = println;
+    core_env_[Intern("gc-stats")] = gc_stats;
+    core_env_[Intern("disassemble")] = disassemble;
 }
 
-const std::unordered_map<std::string, MalNode>& Core::GetEnv() const {
+const std::unordered_map<InternId, MalNode>& Core::GetEnv() const {
     return core_env_;
 }
\ No newline at end of file
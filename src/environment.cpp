@@ -4,43 +4,74 @@
 
 #include "../include/environment.h"
 
-Environment::Environment() : outer_{nullptr} {}
+namespace {
 
-Environment::Environment(Environment* outer) : outer_{outer} {}
+std::uint64_t NextId() {
+    static std::uint64_t next_id = 0;
+    return ++next_id;
+}
+
+} // namespace
+
+Environment::Environment() : GcObject{true}, outer_{}, id_{NextId()} {}
+
+Environment::Environment(GcRef<Environment> outer, bool tracked) : GcObject{tracked}, outer_{outer}, id_{NextId()} {}
 
-Environment::Environment(Environment* outer, const std::vector<std::string>& bind, const std::vector<MalNode>& exprs) : outer_{outer} {
+Environment::Environment(GcRef<Environment> outer, const std::vector<InternId>& bind, const std::vector<MalNode>& exprs,
+    bool tracked) : GcObject{tracked}, outer_{outer}, id_{NextId()} {
     for (std::size_t index = 0; index < bind.size(); index++) {
-        auto& symbol = bind[index];
-        auto& expr = exprs[index];
+        auto symbol = bind[index];
 
-        if (symbol == "&")
+        if (symbol == SpecialForm::Variadic)
         {
             auto more_symbol = bind[index + 1];
 
-            auto remaining_args = std::make_shared<List>();
-            remaining_args->children_ = std::vector<MalNode> {exprs.begin() + index, exprs.end()};
+            auto remaining_args = MalNode::Make<List>();
+            remaining_args.As<List>()->children_ = std::vector<MalNode> {exprs.begin() + index, exprs.end()};
 
             map_[more_symbol] = remaining_args;
             return;
         }
 
-        map_[symbol] = expr;
+        map_[symbol] = exprs[index];
     }
 }
 
 
-void Environment::Set(std::string symbol, MalNode data) {
+void Environment::Set(InternId symbol, MalNode data) {
     map_[symbol] = data;
 }
 
-MalNode Environment::Get(std::string key) {
-    if (map_.contains(key) == 0)
-    {
-        if (outer_ == nullptr)
-            throw std::logic_error(key + " not found!");
+void Environment::Set(std::string_view symbol, MalNode data) {
+    Set(Intern(symbol), data);
+}
+
+MalNode Environment::Get(InternId key) {
+    if (auto cell = Find(key))
+        return *cell;
 
-        return outer_->Get(key);
+    throw std::logic_error(InternTable::Instance().Name(key) + " not found!");
+}
+
+MalNode* Environment::Find(InternId key) {
+    for (auto env = this; env != nullptr; env = env->outer_.get()) {
+        auto it = env->map_.find(key);
+        if (it != env->map_.end())
+            return &it->second;
     }
 
-    return map_[key];
+    return nullptr;
+}
+
+void Environment::Trace(GcVisitor& visitor) {
+    for (auto& [symbol, value] : map_)
+        TraceNode(visitor, value);
+
+    if (outer_)
+        visitor.Visit(outer_.get());
+}
+
+void Environment::Clear() {
+    map_.clear();
+    outer_.reset();
 }
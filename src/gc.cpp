@@ -0,0 +1,158 @@
+#include "../include/gc.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+GcObject::GcObject(bool tracked) : refcount_{0}, tracked_{tracked}, marked_{false}, gc_refs_{0},
+    gc_prev_{nullptr}, gc_next_{nullptr} {
+    if (tracked_)
+        Gc::Instance().Track(this);
+}
+
+GcObject::~GcObject() {
+    if (tracked_)
+        Gc::Instance().Untrack(this);
+}
+
+void* GcObject::operator new(std::size_t size) {
+    Gc::Instance().allocated_++;
+#ifndef MAL_NO_ARENA
+    return Arena::Instance().Allocate(size);
+#else
+    return ::operator new(size);
+#endif
+}
+
+void GcObject::operator delete(void* ptr, std::size_t size) {
+    Gc::Instance().freed_++;
+#ifndef MAL_NO_ARENA
+    Arena::Instance().Free(ptr, size);
+#else
+    ::operator delete(ptr, size);
+#endif
+}
+
+/*
+ * @brief The collector is never destroyed, objects released during static
+ * destruction still unlink themselves from it
+ * */
+Gc& Gc::Instance() {
+    static Gc* gc = new Gc;
+    return *gc;
+}
+
+Gc::Gc() : head_{nullptr}, tracked_{0}, threshold_{0}, min_threshold_{10000}, growth_factor_{2.0},
+    collections_{0}, collected_{0}, allocated_{0}, freed_{0} {
+    if (auto value = std::getenv("MAL_GC_MIN_THRESHOLD"))
+        min_threshold_ = std::stoul(value);
+    if (auto value = std::getenv("MAL_GC_GROWTH_FACTOR"))
+        growth_factor_ = std::stod(value);
+
+    threshold_ = min_threshold_;
+}
+
+void Gc::Track(GcObject* object) {
+    object->gc_prev_ = nullptr;
+    object->gc_next_ = head_;
+    if (head_ != nullptr)
+        head_->gc_prev_ = object;
+    head_ = object;
+    tracked_++;
+}
+
+void Gc::Untrack(GcObject* object) {
+    if (object->gc_prev_ != nullptr)
+        object->gc_prev_->gc_next_ = object->gc_next_;
+    else
+        head_ = object->gc_next_;
+
+    if (object->gc_next_ != nullptr)
+        object->gc_next_->gc_prev_ = object->gc_prev_;
+
+    tracked_--;
+}
+
+void Gc::SetThresholds(std::size_t min_threshold, double growth_factor) {
+    min_threshold_ = min_threshold;
+    growth_factor_ = growth_factor;
+    threshold_ = min_threshold_;
+}
+
+GcStats Gc::Stats() const {
+    return GcStats{collections_, tracked_, collected_, threshold_, allocated_, allocated_ - freed_};
+}
+
+/*
+ * @brief Frees every tracked object that is only reachable from other garbage
+ *
+ * @return Number of objects freed
+ * */
+std::size_t Gc::Collect() {
+    // 1. Count the references each object receives from inside the tracked graph
+    for (auto object = head_; object != nullptr; object = object->gc_next_) {
+        object->gc_refs_ = object->refcount_;
+        object->marked_ = false;
+    }
+
+    struct Subtract : GcVisitor {
+        void Visit(GcObject* object) override {
+            if (object->IsTracked())
+                object->gc_refs_--;
+        }
+    } subtract;
+
+    for (auto object = head_; object != nullptr; object = object->gc_next_)
+        object->Trace(subtract);
+
+    // 2. Objects with outside references, or not yet owned by any handle, are roots
+    std::vector<GcObject*> stack;
+    for (auto object = head_; object != nullptr; object = object->gc_next_) {
+        if (object->gc_refs_ > 0 || object->refcount_ == 0) {
+            object->marked_ = true;
+            stack.push_back(object);
+        }
+    }
+
+    struct Mark : GcVisitor {
+        explicit Mark(std::vector<GcObject*>& stack) : stack_{stack} {}
+
+        void Visit(GcObject* object) override {
+            if (object->IsTracked() && !object->marked_) {
+                object->marked_ = true;
+                stack_.push_back(object);
+            }
+        }
+
+        std::vector<GcObject*>& stack_;
+    } mark {stack};
+
+    while (!stack.empty()) {
+        auto object = stack.back();
+        stack.pop_back();
+        object->Trace(mark);
+    }
+
+    // 3. Hold every unmarked object, break its references, then let the counts free it
+    std::vector<GcObject*> garbage;
+    for (auto object = head_; object != nullptr; object = object->gc_next_) {
+        if (!object->marked_)
+            garbage.push_back(object);
+    }
+
+    for (auto object : garbage)
+        object->Retain();
+    for (auto object : garbage)
+        object->Clear();
+    for (auto object : garbage)
+        object->Release();
+
+    collections_++;
+    collected_ += garbage.size();
+
+    auto survivors = static_cast<double>(tracked_) * growth_factor_;
+    threshold_ = std::max(min_threshold_, static_cast<std::size_t>(survivors));
+
+    return garbage.size();
+}
@@ -0,0 +1,48 @@
+#include "../include/intern.h"
+
+#include <mutex>
+
+InternTable::InternTable() {
+    // Must match the order of SpecialForm
+    for (auto name : {"def!", "let*", "do", "if", "fn*", "&", "lazy-seq"})
+        Intern(name);
+}
+
+InternTable& InternTable::Instance() {
+    static InternTable table;
+    return table;
+}
+
+/*
+ * @brief Returns the id for name, adding it to the table on first use
+ *
+ * @param Symbol or keyword name
+ * @return Dense id
+ * */
+InternId InternTable::Intern(std::string_view name) {
+    {
+        std::shared_lock lock {mutex_};
+        auto it = ids_.find(name);
+        if (it != ids_.end())
+            return it->second;
+    }
+
+    std::unique_lock lock {mutex_};
+    auto it = ids_.find(name);
+    if (it != ids_.end())
+        return it->second;
+
+    auto id = static_cast<InternId>(names_.size());
+    auto& canonical = names_.emplace_back(name);
+    ids_.emplace(canonical, id);
+
+    return id;
+}
+
+/*
+ * @brief Returns the canonical string for an id
+ * */
+const std::string& InternTable::Name(InternId id) const {
+    std::shared_lock lock {mutex_};
+    return names_[id];
+}
@@ -0,0 +1,691 @@
+#include "../include/numarray.h"
+#include "../include/numeric.h"
+
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+// Kernels are cloned for AVX2 and the baseline ISA, and an ifunc resolver picks the clone
+// when the binary is loaded. Without clones the baseline build is all there is.
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(MAL_NO_SIMD_CLONES)
+#define MAL_SIMD_KERNEL __attribute__((target_clones("avx2", "default")))
+#else
+#define MAL_SIMD_KERNEL
+#endif
+
+#define MAL_INLINE_KERNEL [[gnu::always_inline]] inline
+
+namespace {
+
+// One AVX2 register, or two SSE2 ones in the baseline clone
+constexpr std::size_t vector_bytes = 32;
+
+/*
+ * @brief Which operands of an elementwise kernel are arrays, the other one is a single value
+ * */
+enum class Shape : std::uint8_t {
+    Arrays,
+    ScalarLeft,
+    ScalarRight
+};
+
+// The loops below are written over GCC vector types, which lower to whatever the ISA of
+// the enclosing clone has. They are always inlined so each clone gets its own copy, and
+// vectors are only passed by reference, a vector argument would change the ABI.
+
+template<typename V, typename T>
+MAL_INLINE_KERNEL void Broadcast(V& vector, T value) {
+    for (std::size_t lane = 0; lane < sizeof(V) / sizeof(T); lane++)
+        vector[lane] = value;
+}
+
+template<ArrayOp op, typename U>
+MAL_INLINE_KERNEL void Apply(U& out, const U& x, const U& y) {
+    if constexpr (op == ArrayOp::Add)
+        out = x + y;
+    else if constexpr (op == ArrayOp::Subtract)
+        out = x - y;
+    else if constexpr (op == ArrayOp::Multiply)
+        out = x * y;
+    else
+        out = x / y;
+}
+
+/*
+ * @brief Sets the sign bit of out where an integer add or subtract of x and y to result wrapped around
+ * */
+template<ArrayOp op, typename U>
+MAL_INLINE_KERNEL void Wrapped(U& out, const U& x, const U& y, const U& result) {
+    if constexpr (op == ArrayOp::Add)
+        out |= ~(x ^ y) & (x ^ result);
+    else
+        out |= (x ^ y) & (x ^ result);
+}
+
+template<ArrayCompareOp op, typename R, typename U>
+MAL_INLINE_KERNEL void Holds(R& out, const U& x, const U& y) {
+    if constexpr (op == ArrayCompareOp::Less)
+        out = x < y;
+    else if constexpr (op == ArrayCompareOp::LessEqual)
+        out = x <= y;
+    else if constexpr (op == ArrayCompareOp::Greater)
+        out = x > y;
+    else if constexpr (op == ArrayCompareOp::GreaterEqual)
+        out = x >= y;
+    else
+        out = x == y;
+}
+
+/*
+ * @brief Applies op to every element, and for integers, whether any of them wrapped around
+ *
+ * Integer lanes OR what wrapped into one vector, which is tested once after the loop.
+ * */
+template<ArrayOp op, Shape shape, typename T>
+MAL_INLINE_KERNEL bool ElementwiseLoop(const T* a, const T* b, T* out, std::size_t size) {
+    typedef T V __attribute__((vector_size(vector_bytes)));
+    constexpr auto lanes = sizeof(V) / sizeof(T);
+    constexpr auto checked = std::is_integral_v<T>;
+
+    V x, y, result;
+    V wrapped {};
+    if constexpr (shape == Shape::ScalarLeft)
+        Broadcast(x, *a);
+    if constexpr (shape == Shape::ScalarRight)
+        Broadcast(y, *b);
+
+    std::size_t index = 0;
+    for (; index + lanes <= size; index += lanes) {
+        if constexpr (shape != Shape::ScalarLeft)
+            std::memcpy(&x, a + index, sizeof(V));
+        if constexpr (shape != Shape::ScalarRight)
+            std::memcpy(&y, b + index, sizeof(V));
+        Apply<op>(result, x, y);
+        if constexpr (checked)
+            Wrapped<op>(wrapped, x, y, result);
+        std::memcpy(out + index, &result, sizeof(V));
+    }
+
+    T wrapped_any {};
+    for (; index < size; index++) {
+        auto left = shape == Shape::ScalarLeft ? *a : a[index];
+        auto right = shape == Shape::ScalarRight ? *b : b[index];
+        Apply<op>(out[index], left, right);
+        if constexpr (checked)
+            Wrapped<op>(wrapped_any, left, right, out[index]);
+    }
+
+    if constexpr (checked) {
+        for (std::size_t lane = 0; lane < lanes; lane++)
+            wrapped_any |= wrapped[lane];
+        return (wrapped_any >> 63) != 0;
+    }
+    return false;
+}
+
+template<Shape shape, typename T>
+MAL_INLINE_KERNEL bool ElementwiseShaped(ArrayOp op, const T* a, const T* b, T* out, std::size_t size) {
+    switch (op) {
+        case ArrayOp::Add:
+            return ElementwiseLoop<ArrayOp::Add, shape>(a, b, out, size);
+        case ArrayOp::Subtract:
+            return ElementwiseLoop<ArrayOp::Subtract, shape>(a, b, out, size);
+        case ArrayOp::Multiply:
+        case ArrayOp::Divide:
+            // Integer multiply and divide check every element, they have no kernel
+            if constexpr (std::is_floating_point_v<T>) {
+                if (op == ArrayOp::Multiply)
+                    return ElementwiseLoop<ArrayOp::Multiply, shape>(a, b, out, size);
+                return ElementwiseLoop<ArrayOp::Divide, shape>(a, b, out, size);
+            }
+            std::unreachable();
+    }
+    std::unreachable();
+}
+
+template<typename T>
+MAL_INLINE_KERNEL bool Elementwise(ArrayOp op, Shape shape, const T* a, const T* b, T* out, std::size_t size) {
+    switch (shape) {
+        case Shape::Arrays:
+            return ElementwiseShaped<Shape::Arrays>(op, a, b, out, size);
+        case Shape::ScalarLeft:
+            return ElementwiseShaped<Shape::ScalarLeft>(op, a, b, out, size);
+        case Shape::ScalarRight:
+            return ElementwiseShaped<Shape::ScalarRight>(op, a, b, out, size);
+    }
+    std::unreachable();
+}
+
+template<ArrayCompareOp op, Shape shape, typename T>
+MAL_INLINE_KERNEL void CompareLoop(const T* a, const T* b, std::int64_t* out, std::size_t size) {
+    typedef T V __attribute__((vector_size(vector_bytes)));
+    typedef std::int64_t Mask __attribute__((vector_size(vector_bytes)));
+    constexpr auto lanes = sizeof(V) / sizeof(T);
+
+    V x, y;
+    Mask result;
+    if constexpr (shape == Shape::ScalarLeft)
+        Broadcast(x, *a);
+    if constexpr (shape == Shape::ScalarRight)
+        Broadcast(y, *b);
+
+    std::size_t index = 0;
+    for (; index + lanes <= size; index += lanes) {
+        if constexpr (shape != Shape::ScalarLeft)
+            std::memcpy(&x, a + index, sizeof(V));
+        if constexpr (shape != Shape::ScalarRight)
+            std::memcpy(&y, b + index, sizeof(V));
+        // Lanes where the comparison holds are all ones, keep the low bit
+        Holds<op>(result, x, y);
+        result &= 1;
+        std::memcpy(out + index, &result, sizeof(Mask));
+    }
+
+    for (; index < size; index++)
+        Holds<op>(out[index], shape == Shape::ScalarLeft ? *a : a[index], shape == Shape::ScalarRight ? *b : b[index]);
+}
+
+template<Shape shape, typename T>
+MAL_INLINE_KERNEL void CompareShaped(ArrayCompareOp op, const T* a, const T* b, std::int64_t* out, std::size_t size) {
+    switch (op) {
+        case ArrayCompareOp::Less:
+            return CompareLoop<ArrayCompareOp::Less, shape>(a, b, out, size);
+        case ArrayCompareOp::LessEqual:
+            return CompareLoop<ArrayCompareOp::LessEqual, shape>(a, b, out, size);
+        case ArrayCompareOp::Greater:
+            return CompareLoop<ArrayCompareOp::Greater, shape>(a, b, out, size);
+        case ArrayCompareOp::GreaterEqual:
+            return CompareLoop<ArrayCompareOp::GreaterEqual, shape>(a, b, out, size);
+        case ArrayCompareOp::Equal:
+            return CompareLoop<ArrayCompareOp::Equal, shape>(a, b, out, size);
+    }
+}
+
+template<typename T>
+MAL_INLINE_KERNEL void Compare(ArrayCompareOp op, Shape shape, const T* a, const T* b, std::int64_t* out, std::size_t size) {
+    switch (shape) {
+        case Shape::Arrays:
+            return CompareShaped<Shape::Arrays>(op, a, b, out, size);
+        case Shape::ScalarLeft:
+            return CompareShaped<Shape::ScalarLeft>(op, a, b, out, size);
+        case Shape::ScalarRight:
+            return CompareShaped<Shape::ScalarRight>(op, a, b, out, size);
+    }
+}
+
+/*
+ * @brief Sum of the elements, or of the products of a and b when b is not null
+ *
+ * Each lane keeps its own partial sum, so a sum of doubles can differ from a sequential
+ * one in the last bits. For integers, wrapped is set when any partial sum wrapped around.
+ * */
+template<typename T>
+MAL_INLINE_KERNEL T SumLoop(const T* a, const T* b, std::size_t size, bool& wrapped) {
+    typedef T V __attribute__((vector_size(vector_bytes)));
+    constexpr auto lanes = sizeof(V) / sizeof(T);
+    constexpr auto checked = std::is_integral_v<T>;
+
+    V sums {};
+    V wrapped_lanes {};
+    V x, y, next;
+    std::size_t index = 0;
+    for (; index + lanes <= size; index += lanes) {
+        std::memcpy(&x, a + index, sizeof(V));
+        if (b != nullptr) {
+            std::memcpy(&y, b + index, sizeof(V));
+            x *= y;
+        }
+        next = sums + x;
+        if constexpr (checked)
+            Wrapped<ArrayOp::Add>(wrapped_lanes, sums, x, next);
+        sums = next;
+    }
+
+    T sum {};
+    T wrapped_any {};
+    auto add = [&](T value) {
+        auto next = sum + value;
+        if constexpr (checked)
+            Wrapped<ArrayOp::Add>(wrapped_any, sum, value, next);
+        sum = next;
+    };
+
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        add(sums[lane]);
+        if constexpr (checked)
+            wrapped_any |= wrapped_lanes[lane];
+    }
+    for (; index < size; index++)
+        add((b != nullptr) ? a[index] * b[index] : a[index]);
+
+    if constexpr (checked)
+        wrapped = (wrapped_any >> 63) != 0;
+    return sum;
+}
+
+/*
+ * @brief Smallest or largest element of a non-empty array
+ * */
+template<bool max, typename T>
+MAL_INLINE_KERNEL T ExtremeLoop(const T* a, std::size_t size) {
+    typedef T V __attribute__((vector_size(vector_bytes)));
+    constexpr auto lanes = sizeof(V) / sizeof(T);
+
+    T extreme = a[0];
+    std::size_t index = 0;
+    if (size >= lanes) {
+        V extremes, x;
+        std::memcpy(&extremes, a, sizeof(V));
+        for (index = lanes; index + lanes <= size; index += lanes) {
+            std::memcpy(&x, a + index, sizeof(V));
+            extremes = (max ? x > extremes : x < extremes) ? x : extremes;
+        }
+        for (std::size_t lane = 0; lane < lanes; lane++)
+            extreme = (max ? extremes[lane] > extreme : extremes[lane] < extreme) ? extremes[lane] : extreme;
+    }
+
+    for (; index < size; index++)
+        extreme = (max ? a[index] > extreme : a[index] < extreme) ? a[index] : extreme;
+
+    return extreme;
+}
+
+// Integer arithmetic is done on the unsigned type, where overflow wraps instead of being
+// undefined, and the kernels report whether it did
+
+MAL_SIMD_KERNEL void F64Elementwise(ArrayOp op, Shape shape, const double* a, const double* b, double* out, std::size_t size) {
+    Elementwise(op, shape, a, b, out, size);
+}
+
+MAL_SIMD_KERNEL bool I64Elementwise(ArrayOp op, Shape shape, const std::uint64_t* a, const std::uint64_t* b, std::uint64_t* out, std::size_t size) {
+    return Elementwise(op, shape, a, b, out, size);
+}
+
+MAL_SIMD_KERNEL void F64Compare(ArrayCompareOp op, Shape shape, const double* a, const double* b, std::int64_t* out, std::size_t size) {
+    Compare(op, shape, a, b, out, size);
+}
+
+MAL_SIMD_KERNEL void I64Compare(ArrayCompareOp op, Shape shape, const std::int64_t* a, const std::int64_t* b, std::int64_t* out, std::size_t size) {
+    Compare(op, shape, a, b, out, size);
+}
+
+MAL_SIMD_KERNEL double F64Sum(const double* a, const double* b, std::size_t size) {
+    bool wrapped = false;
+    return SumLoop(a, b, size, wrapped);
+}
+
+MAL_SIMD_KERNEL std::uint64_t I64Sum(const std::uint64_t* a, std::size_t size, bool& wrapped) {
+    return SumLoop(a, static_cast<const std::uint64_t*>(nullptr), size, wrapped);
+}
+
+MAL_SIMD_KERNEL double F64Extreme(bool max, const double* a, std::size_t size) {
+    return max ? ExtremeLoop<true>(a, size) : ExtremeLoop<false>(a, size);
+}
+
+MAL_SIMD_KERNEL std::int64_t I64Extreme(bool max, const std::int64_t* a, std::size_t size) {
+    return max ? ExtremeLoop<true>(a, size) : ExtremeLoop<false>(a, size);
+}
+
+template<typename T>
+using Buffer = std::vector<T, AlignedAllocator<T>>;
+
+/*
+ * @brief An operand of an elementwise operation, as the element type of the result
+ * */
+template<typename T>
+struct Operand {
+    const T* Data() const { return scalar_ ? &value_ : data_; }
+
+    bool scalar_ = false;
+    T value_ {};
+    const T* data_ = nullptr;
+    std::size_t size_ = 0;
+    Buffer<T> converted_;  // An i64-array widened for an f64 operation
+};
+
+double NumberToDouble(const MalNode& node) {
+    switch (node.Type()) {
+        case MalType::NodeType::Int:
+            return static_cast<double>(node.AsInt());
+        case MalType::NodeType::Double:
+            return node.AsDouble();
+        case MalType::NodeType::BigInt:
+            return node.As<BigInt>()->ToDouble();
+        default:
+            throw std::logic_error(node.Print(true) + " is not a number!");
+    }
+}
+
+std::int64_t NumberToInt(const MalNode& node) {
+    if (node.Type() != MalType::NodeType::Int)
+        throw std::logic_error(node.Print(true) + " does not fit in an i64-array!");
+
+    return node.AsInt();
+}
+
+bool IsF64(const MalNode& node) {
+    return node.Type() == MalType::NodeType::F64Array || node.Type() == MalType::NodeType::Double;
+}
+
+Operand<double> F64Operand(const MalNode& node) {
+    Operand<double> operand;
+    if (node.Type() == MalType::NodeType::F64Array) {
+        auto& data = node.As<F64Array>()->data_;
+        operand.data_ = data.data();
+        operand.size_ = data.size();
+    } else if (node.Type() == MalType::NodeType::I64Array) {
+        auto& data = node.As<I64Array>()->data_;
+        operand.converted_.assign(data.begin(), data.end());
+        operand.data_ = operand.converted_.data();
+        operand.size_ = data.size();
+    } else {
+        operand.scalar_ = true;
+        operand.value_ = NumberToDouble(node);
+    }
+
+    return operand;
+}
+
+Operand<std::int64_t> I64Operand(const MalNode& node) {
+    Operand<std::int64_t> operand;
+    if (node.Type() == MalType::NodeType::I64Array) {
+        auto& data = node.As<I64Array>()->data_;
+        operand.data_ = data.data();
+        operand.size_ = data.size();
+    } else {
+        operand.scalar_ = true;
+        operand.value_ = NumberToInt(node);
+    }
+
+    return operand;
+}
+
+template<typename T>
+Shape ShapeOf(const Operand<T>& x, const Operand<T>& y) {
+    if (x.scalar_)
+        return Shape::ScalarLeft;
+    if (y.scalar_)
+        return Shape::ScalarRight;
+    if (x.size_ != y.size_)
+        throw std::logic_error("arrays of sizes " + std::to_string(x.size_) + " and " + std::to_string(y.size_) + " do not match!");
+
+    return Shape::Arrays;
+}
+
+template<typename T>
+std::size_t SizeOf(const Operand<T>& x, const Operand<T>& y) {
+    return x.scalar_ ? y.size_ : x.size_;
+}
+
+const std::uint64_t* Unsigned(const std::int64_t* data) {
+    return reinterpret_cast<const std::uint64_t*>(data);
+}
+
+void ThrowOverflow() {
+    throw std::logic_error("result does not fit in an i64-array!");
+}
+
+/*
+ * @brief Checked i64 multiplication, AVX2 has no 64-bit multiply to build a kernel on
+ * */
+void I64Multiply(const Operand<std::int64_t>& x, const Operand<std::int64_t>& y, std::int64_t* out, std::size_t size) {
+    for (std::size_t index = 0; index < size; index++) {
+        if (__builtin_mul_overflow(x.scalar_ ? x.value_ : x.data_[index], y.scalar_ ? y.value_ : y.data_[index], &out[index]))
+            ThrowOverflow();
+    }
+}
+
+/*
+ * @brief Truncating i64 division, the kernels have none
+ * */
+void I64Divide(const Operand<std::int64_t>& x, const Operand<std::int64_t>& y, std::int64_t* out, std::size_t size) {
+    for (std::size_t index = 0; index < size; index++) {
+        auto dividend = x.scalar_ ? x.value_ : x.data_[index];
+        auto divisor = y.scalar_ ? y.value_ : y.data_[index];
+        if (divisor == 0)
+            throw std::logic_error("division by zero!");
+        if (divisor == -1 && dividend == std::numeric_limits<std::int64_t>::min())
+            ThrowOverflow();
+
+        out[index] = dividend / divisor;
+    }
+}
+
+/*
+ * @brief Sum of the elements, or of the products of x and y, exactly
+ *
+ * A result past the Int range is a BigInt, as it would be for the same numbers in a list.
+ * Int arithmetic checked for overflow covers the common case, the numeric tower is the
+ * fallback once it overflows.
+ * */
+MalNode I64ExactSum(const std::int64_t* x, const std::int64_t* y, std::size_t size) {
+    bool wrapped = false;
+    std::int64_t fast_sum = 0;
+    if (y == nullptr) {
+        fast_sum = static_cast<std::int64_t>(I64Sum(Unsigned(x), size, wrapped));
+    } else {
+        for (std::size_t index = 0; index < size && !wrapped; index++) {
+            std::int64_t product;
+            wrapped = __builtin_mul_overflow(x[index], y[index], &product) || __builtin_add_overflow(fast_sum, product, &fast_sum);
+        }
+    }
+
+    if (!wrapped)
+        return MalNode::Int(fast_sum);
+
+    auto sum = MalNode::Int(0);
+    for (std::size_t index = 0; index < size; index++)
+        sum = AddNumbers(sum, (y == nullptr) ? MalNode::Int(x[index]) : MultiplyNumbers(MalNode::Int(x[index]), MalNode::Int(y[index])));
+
+    return sum;
+}
+
+template<typename T, typename F>
+void FillFrom(const MalNode& source, Buffer<T>& data, F&& convert) {
+    switch (source.Type()) {
+        case MalType::NodeType::Int:
+            if (source.AsInt() < 0)
+                throw std::logic_error("array size must be non-negative!");
+            data.resize(static_cast<std::size_t>(source.AsInt()));
+            return;
+        case MalType::NodeType::Vector: {
+            auto vector = source.As<Vector>();
+            data.reserve(vector->Size());
+            vector->ForEach([&](const MalNode& element) { data.push_back(convert(element)); });
+            return;
+        }
+        default:
+            if (!IsSeq(source))
+                throw std::logic_error("an array is made of a seq of numbers or of a size!");
+            for (SeqCursor cursor {source}; !cursor.Done(); cursor.Next())
+                data.push_back(convert(cursor.Get()));
+    }
+}
+
+} // namespace
+
+template<typename T>
+void PackedArray<T>::PrintTo(std::string& out, bool print_readably) {
+    out += std::is_same_v<T, double> ? "#f64[" : "#i64[";
+    for (std::size_t index = 0; index < data_.size(); index++) {
+        if (index > 0)
+            out += ' ';
+        if constexpr (std::is_same_v<T, double>)
+            MalNode::Double(data_[index]).PrintTo(out, print_readably);
+        else
+            MalNode::Int(data_[index]).PrintTo(out, print_readably);
+    }
+    out += ']';
+}
+
+template<typename T>
+bool PackedArray<T>::operator==(MalType& other) {
+    if (other.type_ != type_)
+        return false;
+
+    return data_ == static_cast<PackedArray*>(&other)->data_;
+}
+
+template<typename T>
+std::size_t PackedArray<T>::Hash() {
+    std::size_t hash = static_cast<std::size_t>(type_);
+    for (auto element : data_)
+        hash = hash * 31 + std::hash<T>{}(element);
+
+    return hash;
+}
+
+template struct PackedArray<double>;
+template struct PackedArray<std::int64_t>;
+
+MalNode MakeF64Array(const MalNode& source) {
+    auto array = MalNode::Make<F64Array>(0);
+    auto& data = array.As<F64Array>()->data_;
+
+    switch (source.Type()) {
+        case MalType::NodeType::F64Array:
+            data = source.As<F64Array>()->data_;
+            break;
+        case MalType::NodeType::I64Array: {
+            auto& integers = source.As<I64Array>()->data_;
+            data.assign(integers.begin(), integers.end());
+            break;
+        }
+        default:
+            FillFrom(source, data, NumberToDouble);
+    }
+
+    return array;
+}
+
+MalNode MakeI64Array(const MalNode& source) {
+    auto array = MalNode::Make<I64Array>(0);
+    auto& data = array.As<I64Array>()->data_;
+
+    switch (source.Type()) {
+        case MalType::NodeType::I64Array:
+            data = source.As<I64Array>()->data_;
+            break;
+        case MalType::NodeType::F64Array:
+            throw std::logic_error("an f64-array does not fit in an i64-array!");
+        default:
+            FillFrom(source, data, NumberToInt);
+    }
+
+    return array;
+}
+
+MalNode ArrayToVector(const MalNode& array) {
+    auto vector = MalNode::Make<Vector>();
+    if (array.Type() == MalType::NodeType::F64Array) {
+        for (auto element : array.As<F64Array>()->data_)
+            vector.As<Vector>()->Add(MalNode::Double(element));
+    } else {
+        for (auto element : array.As<I64Array>()->data_)
+            vector.As<Vector>()->Add(MalNode::Int(element));
+    }
+
+    return vector;
+}
+
+MalNode ArrayNth(const MalNode& array, std::size_t index) {
+    if (array.Type() == MalType::NodeType::F64Array) {
+        auto& data = array.As<F64Array>()->data_;
+        if (index >= data.size())
+            throw std::logic_error("index out of bounds!");
+        return MalNode::Double(data[index]);
+    }
+
+    auto& data = array.As<I64Array>()->data_;
+    if (index >= data.size())
+        throw std::logic_error("index out of bounds!");
+    return MalNode::Int(data[index]);
+}
+
+MalNode ArrayArithmetic(ArrayOp op, const MalNode& a, const MalNode& b) {
+    if (IsF64(a) || IsF64(b)) {
+        auto x = F64Operand(a);
+        auto y = F64Operand(b);
+        auto shape = ShapeOf(x, y);
+        auto size = SizeOf(x, y);
+
+        auto result = MalNode::Make<F64Array>(size);
+        F64Elementwise(op, shape, x.Data(), y.Data(), result.As<F64Array>()->data_.data(), size);
+        return result;
+    }
+
+    auto x = I64Operand(a);
+    auto y = I64Operand(b);
+    auto shape = ShapeOf(x, y);
+    auto size = SizeOf(x, y);
+
+    auto result = MalNode::Make<I64Array>(size);
+    auto out = result.As<I64Array>()->data_.data();
+    if (op == ArrayOp::Multiply)
+        I64Multiply(x, y, out, size);
+    else if (op == ArrayOp::Divide)
+        I64Divide(x, y, out, size);
+    else if (I64Elementwise(op, shape, Unsigned(x.Data()), Unsigned(y.Data()), reinterpret_cast<std::uint64_t*>(out), size))
+        ThrowOverflow();
+    return result;
+}
+
+MalNode ArrayCompare(ArrayCompareOp op, const MalNode& a, const MalNode& b) {
+    if (IsF64(a) || IsF64(b)) {
+        auto x = F64Operand(a);
+        auto y = F64Operand(b);
+        auto shape = ShapeOf(x, y);
+        auto size = SizeOf(x, y);
+
+        auto result = MalNode::Make<I64Array>(size);
+        F64Compare(op, shape, x.Data(), y.Data(), result.As<I64Array>()->data_.data(), size);
+        return result;
+    }
+
+    auto x = I64Operand(a);
+    auto y = I64Operand(b);
+    auto shape = ShapeOf(x, y);
+    auto size = SizeOf(x, y);
+
+    auto result = MalNode::Make<I64Array>(size);
+    I64Compare(op, shape, x.Data(), y.Data(), result.As<I64Array>()->data_.data(), size);
+    return result;
+}
+
+MalNode ArrayReduce(ArrayReduceOp op, const MalNode& array) {
+    if (!IsArray(array))
+        throw std::logic_error(array.Print(true) + " is not an array!");
+
+    if (array.Type() == MalType::NodeType::F64Array) {
+        auto& data = array.As<F64Array>()->data_;
+        if (op == ArrayReduceOp::Sum)
+            return MalNode::Double(F64Sum(data.data(), nullptr, data.size()));
+        if (data.empty())
+            throw std::logic_error("min and max of an empty array!");
+        return MalNode::Double(F64Extreme(op == ArrayReduceOp::Max, data.data(), data.size()));
+    }
+
+    auto& data = array.As<I64Array>()->data_;
+    if (op == ArrayReduceOp::Sum)
+        return I64ExactSum(data.data(), nullptr, data.size());
+    if (data.empty())
+        throw std::logic_error("min and max of an empty array!");
+    return MalNode::Int(I64Extreme(op == ArrayReduceOp::Max, data.data(), data.size()));
+}
+
+MalNode ArrayDot(const MalNode& a, const MalNode& b) {
+    if (!IsArray(a) || !IsArray(b))
+        throw std::logic_error("dot takes two arrays!");
+
+    if (IsF64(a) || IsF64(b)) {
+        auto x = F64Operand(a);
+        auto y = F64Operand(b);
+        ShapeOf(x, y);
+        return MalNode::Double(F64Sum(x.Data(), y.Data(), x.size_));
+    }
+
+    auto x = I64Operand(a);
+    auto y = I64Operand(b);
+    ShapeOf(x, y);
+    return I64ExactSum(x.Data(), y.Data(), x.size_);
+}
@@ -0,0 +1,400 @@
+#include "../include/numeric.h"
+#include "../include/numarray.h"
+
+#include <bit>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+using Limbs = std::vector<std::uint32_t>;
+
+constexpr std::uint64_t limb_base = std::uint64_t{1} << 32;
+constexpr std::uint32_t decimal_base = 1000000000;     // the largest power of 10 in a limb
+constexpr int decimal_digits = 9;
+
+void Trim(Limbs& limbs) {
+    while (!limbs.empty() && limbs.back() == 0)
+        limbs.pop_back();
+}
+
+Limbs FromU64(std::uint64_t value) {
+    Limbs limbs;
+    for (; value != 0; value >>= 32)
+        limbs.push_back(static_cast<std::uint32_t>(value));
+
+    return limbs;
+}
+
+int CompareMagnitudes(const Limbs& a, const Limbs& b) {
+    if (a.size() != b.size())
+        return a.size() < b.size() ? -1 : 1;
+
+    for (auto index = a.size(); index-- > 0; ) {
+        if (a[index] != b[index])
+            return a[index] < b[index] ? -1 : 1;
+    }
+
+    return 0;
+}
+
+Limbs AddMagnitudes(const Limbs& a, const Limbs& b) {
+    auto& longer = (a.size() >= b.size()) ? a : b;
+    auto& shorter = (a.size() >= b.size()) ? b : a;
+
+    Limbs sum(longer.size() + 1);
+    std::uint64_t carry = 0;
+    for (std::size_t index = 0; index < longer.size(); index++) {
+        carry += longer[index];
+        if (index < shorter.size())
+            carry += shorter[index];
+
+        sum[index] = static_cast<std::uint32_t>(carry);
+        carry >>= 32;
+    }
+    sum.back() = static_cast<std::uint32_t>(carry);
+
+    Trim(sum);
+    return sum;
+}
+
+/*
+ * @brief a - b, for a no smaller than b
+ * */
+Limbs SubtractMagnitudes(const Limbs& a, const Limbs& b) {
+    Limbs difference(a.size());
+    std::int64_t borrow = 0;
+    for (std::size_t index = 0; index < a.size(); index++) {
+        auto digit = static_cast<std::int64_t>(a[index]) - borrow - (index < b.size() ? static_cast<std::int64_t>(b[index]) : 0);
+        borrow = digit < 0;
+        difference[index] = static_cast<std::uint32_t>(digit);
+    }
+
+    Trim(difference);
+    return difference;
+}
+
+Limbs MultiplyMagnitudes(const Limbs& a, const Limbs& b) {
+    if (a.empty() || b.empty())
+        return {};
+
+    Limbs product(a.size() + b.size());
+    for (std::size_t i = 0; i < a.size(); i++) {
+        std::uint64_t carry = 0;
+        for (std::size_t j = 0; j < b.size(); j++) {
+            carry += static_cast<std::uint64_t>(a[i]) * b[j] + product[i + j];
+            product[i + j] = static_cast<std::uint32_t>(carry);
+            carry >>= 32;
+        }
+        product[i + b.size()] = static_cast<std::uint32_t>(carry);
+    }
+
+    Trim(product);
+    return product;
+}
+
+/*
+ * @brief Divides a by a single limb in place
+ *
+ * @return Remainder
+ * */
+std::uint32_t DivideByLimb(Limbs& a, std::uint32_t divisor) {
+    std::uint64_t remainder = 0;
+    for (auto index = a.size(); index-- > 0; ) {
+        auto current = (remainder << 32) | a[index];
+        a[index] = static_cast<std::uint32_t>(current / divisor);
+        remainder = current % divisor;
+    }
+
+    Trim(a);
+    return static_cast<std::uint32_t>(remainder);
+}
+
+/*
+ * @brief Quotient of a by a non-zero b, truncated (Knuth's algorithm D)
+ * */
+Limbs DivideMagnitudes(const Limbs& a, const Limbs& b) {
+    if (CompareMagnitudes(a, b) < 0)
+        return {};
+
+    if (b.size() == 1) {
+        auto quotient = a;
+        DivideByLimb(quotient, b[0]);
+        return quotient;
+    }
+
+    // Shift both so the divisor's top limb has its high bit set, which keeps each
+    // estimated quotient limb at most 2 too large
+    auto shift = std::countl_zero(b.back());
+    auto n = b.size();
+    auto m = a.size() - n;
+
+    Limbs v(n), u(a.size() + 1);
+    for (std::size_t index = n; index-- > 0; )
+        v[index] = (b[index] << shift) | (shift != 0 && index > 0 ? b[index - 1] >> (32 - shift) : 0);
+    u[a.size()] = (shift != 0) ? a.back() >> (32 - shift) : 0;
+    for (std::size_t index = a.size(); index-- > 0; )
+        u[index] = (a[index] << shift) | (shift != 0 && index > 0 ? a[index - 1] >> (32 - shift) : 0);
+
+    Limbs quotient(m + 1);
+    for (std::size_t j = m + 1; j-- > 0; ) {
+        auto numerator = (static_cast<std::uint64_t>(u[j + n]) << 32) | u[j + n - 1];
+        auto estimate = numerator / v[n - 1];
+        auto remainder = numerator % v[n - 1];
+
+        while (estimate >= limb_base || estimate * v[n - 2] > ((remainder << 32) | u[j + n - 2])) {
+            estimate--;
+            remainder += v[n - 1];
+            if (remainder >= limb_base)
+                break;
+        }
+
+        // u[j..j+n] -= estimate * v
+        std::int64_t borrow = 0;
+        std::uint64_t carry = 0;
+        for (std::size_t index = 0; index < n; index++) {
+            auto product = estimate * v[index] + carry;
+            carry = product >> 32;
+
+            auto digit = static_cast<std::int64_t>(u[index + j]) - static_cast<std::int64_t>(product & 0xffffffff) - borrow;
+            u[index + j] = static_cast<std::uint32_t>(digit);
+            borrow = digit < 0;
+        }
+        auto top = static_cast<std::int64_t>(u[j + n]) - static_cast<std::int64_t>(carry) - borrow;
+        u[j + n] = static_cast<std::uint32_t>(top);
+
+        // The estimate was one too large, add v back
+        if (top < 0) {
+            estimate--;
+            std::uint64_t sum = 0;
+            for (std::size_t index = 0; index < n; index++) {
+                sum += static_cast<std::uint64_t>(u[index + j]) + v[index];
+                u[index + j] = static_cast<std::uint32_t>(sum);
+                sum >>= 32;
+            }
+            u[j + n] += static_cast<std::uint32_t>(sum);
+        }
+
+        quotient[j] = static_cast<std::uint32_t>(estimate);
+    }
+
+    Trim(quotient);
+    return quotient;
+}
+
+/*
+ * @brief An integer as a sign and a magnitude
+ * */
+struct Integer {
+    bool negative_;
+    Limbs limbs_;
+};
+
+Integer ToInteger(const MalNode& node) {
+    if (node.Type() == MalType::NodeType::BigInt) {
+        auto big = node.As<BigInt>();
+        return Integer{big->negative_, big->limbs_};
+    }
+
+    auto value = node.AsInt();
+    // Negated as unsigned, so INT64_MIN does not overflow
+    auto magnitude = (value < 0) ? std::uint64_t{0} - static_cast<std::uint64_t>(value) : static_cast<std::uint64_t>(value);
+    return Integer{value < 0, FromU64(magnitude)};
+}
+
+/*
+ * @brief The integer as an Int when it fits in one, otherwise as a BigInt
+ * */
+MalNode FromInteger(Integer integer) {
+    if (integer.limbs_.empty())
+        return MalNode::Int(0);
+
+    if (integer.limbs_.size() <= 2) {
+        std::uint64_t magnitude = integer.limbs_[0];
+        if (integer.limbs_.size() == 2)
+            magnitude |= static_cast<std::uint64_t>(integer.limbs_[1]) << 32;
+
+        constexpr auto int_max = static_cast<std::uint64_t>(INT64_MAX);
+        if (!integer.negative_ && magnitude <= int_max)
+            return MalNode::Int(static_cast<std::int64_t>(magnitude));
+        if (integer.negative_ && magnitude <= int_max + 1)
+            return MalNode::Int(static_cast<std::int64_t>(std::uint64_t{0} - magnitude));
+    }
+
+    return MalNode::Make<BigInt>(integer.negative_, std::move(integer.limbs_));
+}
+
+Integer AddIntegers(const Integer& a, const Integer& b) {
+    if (a.negative_ == b.negative_)
+        return Integer{a.negative_, AddMagnitudes(a.limbs_, b.limbs_)};
+
+    // Opposite signs, the larger magnitude decides the sign
+    if (CompareMagnitudes(a.limbs_, b.limbs_) >= 0)
+        return Integer{a.negative_, SubtractMagnitudes(a.limbs_, b.limbs_)};
+
+    return Integer{b.negative_, SubtractMagnitudes(b.limbs_, a.limbs_)};
+}
+
+int CompareIntegers(const Integer& a, const Integer& b) {
+    if (a.negative_ != b.negative_)
+        return a.negative_ ? -1 : 1;
+
+    auto magnitude = CompareMagnitudes(a.limbs_, b.limbs_);
+    return a.negative_ ? -magnitude : magnitude;
+}
+
+bool IsInteger(const MalNode& node) {
+    return node.Type() == MalType::NodeType::Int || node.Type() == MalType::NodeType::BigInt;
+}
+
+double ToDouble(const MalNode& node) {
+    switch (node.Type()) {
+        case MalType::NodeType::Int:
+            return static_cast<double>(node.AsInt());
+        case MalType::NodeType::Double:
+            return node.AsDouble();
+        case MalType::NodeType::BigInt:
+            return node.As<BigInt>()->ToDouble();
+        default:
+            throw std::logic_error(node.Print(true) + " is not a number!");
+    }
+}
+
+/*
+ * @brief Checks the operands of an integer operation, false if either is a Double instead
+ * */
+bool BothIntegers(const MalNode& a, const MalNode& b) {
+    if (IsInteger(a) && IsInteger(b))
+        return true;
+
+    // Throws for anything that is not a number
+    ToDouble(a);
+    ToDouble(b);
+    return false;
+}
+
+} // namespace
+
+double BigInt::ToDouble() const {
+    double value = 0;
+    for (auto index = limbs_.size(); index-- > 0; )
+        value = value * static_cast<double>(limb_base) + limbs_[index];
+
+    return negative_ ? -value : value;
+}
+
+void BigInt::PrintTo(std::string& out, [[maybe_unused]] bool print_readably) {
+    // Split into base 10^9 digits, least significant first
+    std::vector<std::uint32_t> chunks;
+    auto magnitude = limbs_;
+    while (!magnitude.empty())
+        chunks.push_back(DivideByLimb(magnitude, decimal_base));
+
+    if (negative_)
+        out += '-';
+    out += std::to_string(chunks.back());
+    for (auto index = chunks.size() - 1; index-- > 0; ) {
+        auto digits = std::to_string(chunks[index]);
+        out.append(decimal_digits - digits.size(), '0');
+        out += digits;
+    }
+}
+
+bool BigInt::operator==(MalType& other) {
+    if (other.type_ != type_)
+        return false;
+
+    auto other_big = static_cast<BigInt*>(&other);
+    return negative_ == other_big->negative_ && limbs_ == other_big->limbs_;
+}
+
+std::size_t BigInt::Hash() {
+    std::size_t hash = negative_;
+    for (auto limb : limbs_)
+        hash = hash * 31 + limb;
+
+    return std::hash<std::size_t>{}(hash);
+}
+
+MalNode AddSlow(const MalNode& a, const MalNode& b) {
+    if (IsArray(a) || IsArray(b))
+        return ArrayArithmetic(ArrayOp::Add, a, b);
+    if (!BothIntegers(a, b))
+        return MalNode::Double(ToDouble(a) + ToDouble(b));
+
+    return FromInteger(AddIntegers(ToInteger(a), ToInteger(b)));
+}
+
+MalNode SubtractSlow(const MalNode& a, const MalNode& b) {
+    if (IsArray(a) || IsArray(b))
+        return ArrayArithmetic(ArrayOp::Subtract, a, b);
+    if (!BothIntegers(a, b))
+        return MalNode::Double(ToDouble(a) - ToDouble(b));
+
+    auto negated = ToInteger(b);
+    negated.negative_ = !negated.negative_;
+    return FromInteger(AddIntegers(ToInteger(a), negated));
+}
+
+MalNode MultiplySlow(const MalNode& a, const MalNode& b) {
+    if (IsArray(a) || IsArray(b))
+        return ArrayArithmetic(ArrayOp::Multiply, a, b);
+    if (!BothIntegers(a, b))
+        return MalNode::Double(ToDouble(a) * ToDouble(b));
+
+    auto x = ToInteger(a);
+    auto y = ToInteger(b);
+    return FromInteger(Integer{x.negative_ != y.negative_, MultiplyMagnitudes(x.limbs_, y.limbs_)});
+}
+
+MalNode DivideSlow(const MalNode& a, const MalNode& b) {
+    if (IsArray(a) || IsArray(b))
+        return ArrayArithmetic(ArrayOp::Divide, a, b);
+    if (!BothIntegers(a, b))
+        return MalNode::Double(ToDouble(a) / ToDouble(b));
+
+    auto x = ToInteger(a);
+    auto y = ToInteger(b);
+    if (y.limbs_.empty())
+        throw std::logic_error("division by zero!");
+
+    return FromInteger(Integer{x.negative_ != y.negative_, DivideMagnitudes(x.limbs_, y.limbs_)});
+}
+
+int CompareSlow(const MalNode& a, const MalNode& b) {
+    if (!BothIntegers(a, b)) {
+        auto x = ToDouble(a);
+        auto y = ToDouble(b);
+        return (x > y) - (x < y);
+    }
+
+    return CompareIntegers(ToInteger(a), ToInteger(b));
+}
+
+MalNode ParseInteger(std::string_view digits) {
+    Integer integer {false, {}};
+    if (!digits.empty() && (digits[0] == '-' || digits[0] == '+')) {
+        integer.negative_ = digits[0] == '-';
+        digits.remove_prefix(1);
+    }
+
+    // Nine digits at a time: magnitude = magnitude * 10^k + chunk
+    for (std::size_t start = 0; start < digits.size(); ) {
+        // The first chunk takes the leftover digits, so the others are nine each
+        std::size_t size = (start == 0 && digits.size() % decimal_digits != 0) ? digits.size() % decimal_digits : decimal_digits;
+
+        std::uint32_t chunk = 0;
+        std::uint32_t scale = 1;
+        for (auto c : digits.substr(start, size)) {
+            if (c < '0' || c > '9')
+                throw std::logic_error("invalid integer " + std::string{digits} + "!");
+            chunk = chunk * 10 + static_cast<std::uint32_t>(c - '0');
+            scale *= 10;
+        }
+
+        integer.limbs_ = AddMagnitudes(MultiplyMagnitudes(integer.limbs_, Limbs{scale}), FromU64(chunk));
+        start += size;
+    }
+
+    return FromInteger(std::move(integer));
+}
@@ -1,5 +1,33 @@
 #include "../include/printer.h"
 
+#include <iostream>
+#include <utility>
+
 std::string PrintAst( [[ maybe_unused ]] MalNode node) {
-    return node->Print(true);
-}
\ No newline at end of file
+    return node.Print(true);
+}
+
+void PrintNodes(const std::vector<MalNode>& nodes, std::string& out, bool print_readably, bool spaced) {
+    for (std::size_t index = 0; index < nodes.size(); index++) {
+        if (spaced && index != 0)
+            out += ' ';
+
+        nodes[index].PrintTo(out, print_readably);
+    }
+}
+
+void PrintLine(const std::vector<MalNode>& nodes, bool print_readably) {
+    thread_local std::string buffer;
+
+    // Taken rather than shared: a lazy seq realized while printing can print a line of its own
+    auto out = std::move(buffer);
+    out.clear();
+    PrintNodes(nodes, out, print_readably, true);
+    out += '\n';
+
+    std::cout.write(out.data(), static_cast<std::streamsize>(out.size()));
+
+    // Keep the buffer for the next line, unless a huge value grew it
+    if (out.capacity() <= 1 << 20)
+        buffer = std::move(out);
+}
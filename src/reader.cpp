@@ -1,47 +1,142 @@
 #include "../include/reader.h"
+#include "../include/numeric.h"
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace {
+
+enum CharClass : std::uint8_t {
+    kSpace = 1 << 0,      // [\s,], skipped between tokens
+    kAtomStop = 1 << 1,   // characters that terminate an atom
+    kSpecial = 1 << 2,    // single character tokens
+    kLineEnd = 1 << 3     // characters '.' does not match
+};
+
+constexpr std::array<std::uint8_t, 256> MakeCharTable() {
+    std::array<std::uint8_t, 256> table {};
+
+    for (unsigned char c : std::string_view{" \t\n\v\f\r,"})
+        table[c] |= kSpace | kAtomStop;
+    for (unsigned char c : std::string_view{"[]{}('\"`;)"})
+        table[c] |= kAtomStop;
+    for (unsigned char c : std::string_view{"[]{}()'`~^@"})
+        table[c] |= kSpecial;
+    for (unsigned char c : std::string_view{"\n\r"})
+        table[c] |= kLineEnd;
+
+    return table;
+}
+
+constexpr auto char_table = MakeCharTable();
+
+inline bool Is(char c, CharClass cls) {
+    return char_table[static_cast<unsigned char>(c)] & cls;
+}
+
+/*
+ * @brief Character at index, or '\0' past the end (the End token is empty)
+ * */
+inline char CharAt(std::string_view token, std::size_t index) {
+    return (index < token.size()) ? token[index] : '\0';
+}
+
+} // namespace
+
+Token Lexer::Next() {
+    auto size = src_.size();
+
+    while (pos_ < size && Is(src_[pos_], kSpace))
+        pos_++;
+
+    if (pos_ >= size)
+        return Token{Token::Kind::End, src_.substr(size, 0)};
+
+    auto start = pos_;
+    auto c = src_[pos_];
+    Token::Kind kind;
+
+    if (c == '~' && pos_ + 1 < size && src_[pos_ + 1] == '@') {
+        pos_ += 2;
+        kind = Token::Kind::Special;
+    } else if (Is(c, kSpecial)) {
+        pos_++;
+        kind = Token::Kind::Special;
+    } else if (c == '"') {
+        pos_++;
+        while (pos_ < size) {
+            if (src_[pos_] == '\\') {
+                // An escape that swallows a line end does not match, and ends the token
+                if (pos_ + 1 >= size || Is(src_[pos_ + 1], kLineEnd))
+                    break;
+                pos_ += 2;
+            } else if (src_[pos_] == '"') {
+                pos_++;
+                break;
+            } else {
+                pos_++;
+            }
+        }
+        kind = Token::Kind::String;
+    } else if (c == ';') {
+        while (pos_ < size && !Is(src_[pos_], kLineEnd))
+            pos_++;
+        kind = Token::Kind::Comment;
+    } else {
+        while (pos_ < size && !Is(src_[pos_], kAtomStop))
+            pos_++;
+        kind = Token::Kind::Atom;
+    }
+
+    return Token{kind, src_.substr(start, pos_ - start)};
+}
 
-std::optional<std::string> Reader::Next() {
+std::optional<std::string_view> Reader::Next() {
     if (index_ >= tokens_.size())
         return std::nullopt;
 
-    auto token = tokens_[index_];
+    auto token = tokens_[index_].text_;
     index_++;
 
     return token;
 }
 
-std::optional<std::string> Reader::Peek() {
+std::optional<std::string_view> Reader::Peek() {
     if (index_ >= tokens_.size())
         return std::nullopt;
 
-    return tokens_[index_];
+    return tokens_[index_].text_;
 }
 
 void Reader::Tokenize() {
-    std::regex lisp_regex {lisp_regex_str};
+    Lexer lexer {src_};
 
-    auto tokens_begin = std::sregex_iterator (src_.begin(), src_.end(), lisp_regex);
-    auto tokens_end = std::sregex_iterator ();
+    while (true) {
+        auto token = lexer.Next();
 
-    for (auto i = tokens_begin; i != tokens_end; i++) {
-        std::smatch match = *i;
-        std::string match_str = match[1].str();
-
-        if (match_str[0] == ';')
+        if (token.kind_ == Token::Kind::Comment)
             continue;
 
-        tokens_.push_back(match_str);
+        tokens_.push_back(token);
+
+        if (token.kind_ == Token::Kind::End)
+            break;
     }
 }
 
 MalNode Reader::ReadForm() {
     if (Peek() == std::nullopt)
-        return nullptr;
+        return MalNode::Nil();
 
     auto token = Peek().value();
 
-    MalNode node = nullptr;
-    switch (token[0]) {
+    MalNode node;
+    switch (CharAt(token, 0)) {
         case '(' : {
             node = ReadSequence<List>();
             break;
@@ -66,33 +161,31 @@ MalNode Reader::ReadForm() {
 MalNode Reader::ReadHashMap() {
     Next(); // '{'
 
-    std::unordered_map<std::string, MalNode> kv;
+    auto node = MalNode::Make<HashMap>();
     while (Peek().has_value() && Peek().value() != "}" && Peek().value() != "") {
-        auto key = Next().value();
-        auto val = ReadForm();
+        auto key = ReadForm();
+        if (!Peek().has_value() || Peek().value() == "}" || Peek().value() == "")
+            throw std::logic_error("hash-map key without a value!");
 
-        kv[key] = val;
+        node.As<HashMap>()->Add(std::move(key), ReadForm());
     }
 
     auto terminator = Next().value(); // '}'
     if (terminator != "}")
         throw std::logic_error("unbalanced");
 
-    auto node = std::make_shared<HashMap>();
-    node->kv_ = std::move(kv);
-
     return node;
 }
 
 MalNode Reader::ReadAtom() {
     if (Peek() == std::nullopt)
-        return nullptr;
+        return MalNode::Nil();
 
     auto token = Peek().value();
 
-    MalNode node = nullptr;
+    MalNode node;
 
-    switch (token[0]) {
+    switch (CharAt(token, 0)) {
         case '+':
         case '*':
         case '/': {
@@ -100,7 +193,7 @@ MalNode Reader::ReadAtom() {
             break;
         }
         case '-': {
-            if (token[0] == '-' && std::isdigit(token[1])) {
+            if (std::isdigit(CharAt(token, 1))) {
                 node = ReadNum();
                 break;
             } else {
@@ -110,7 +203,7 @@ MalNode Reader::ReadAtom() {
         }
         case ':': {
             Next();
-            node = std::make_shared<Keyword>(token);
+            node = MalNode::Keyword(Intern(token.substr(1)));
             break;
         }
         case '"' : {
@@ -130,26 +223,26 @@ MalNode Reader::ReadAtom() {
             break;
         }
         default : {
-            if (std::isdigit(token[0])) {
+            if (std::isdigit(CharAt(token, 0))) {
                 node = ReadNum();
                 break;
             } else if (token == "nil") {
                 Next();
-                node = std::make_shared<Nil>();
+                node = MalNode::Nil();
                 break;
-            } else if (token[0] == '\"' && token.back() == '\"') {
+            } else if (CharAt(token, 0) == '\"' && token.back() == '\"') {
                 node = ReadString();
                 break;
             } else if (token == "true" || token == "false") {
                 Next();
-                node = (token == "true") ? std::make_shared<Boolean>(true) : std::make_shared<Boolean>(false);
+                node = MalNode::Boolean(token == "true");
                 break;
-            } else if (std::isgraph(token[0])) {
+            } else if (std::isgraph(CharAt(token, 0))) {
                 Next();
-                node = std::make_shared<Symbol>(token);
+                node = MalNode::Symbol(Intern(token));
                 break;
             } else {
-                node = std::make_shared<Nil>();
+                node = MalNode::Nil();
                 break;
             }
         }
@@ -160,19 +253,27 @@ MalNode Reader::ReadAtom() {
 
 MalNode Reader::ReadSymbol() {
     auto token = Next().value();
-    return std::make_shared<Symbol>(token);
+    return MalNode::Symbol(Intern(token));
 }
 
 MalNode Reader::ReadNum() {
     auto token = Next().value();
-
-    MalNode node = nullptr;
-    if (token.find('.') != std::string::npos)
-        node = std::make_shared<Double>(std::stod(token));
-    else
-        node = std::make_shared<Int>(std::stoi(token));
-
-    return node;
+    auto begin = token.data();
+    auto end = token.data() + token.size();
+
+    std::int64_t integer;
+    auto [integer_end, integer_error] = std::from_chars(begin, end, integer);
+    if (integer_end == end && integer_error == std::errc{})
+        return MalNode::Int(integer);
+    if (integer_end == end && integer_error == std::errc::result_out_of_range)
+        return ParseInteger(token);
+
+    double number;
+    auto [number_end, number_error] = std::from_chars(begin, end, number);
+    if (number_end == end && number_error == std::errc{})
+        return MalNode::Double(number);
+
+    throw std::logic_error("invalid number " + std::string{token} + "!");
 }
 
 MalNode Reader::ReadString() {
@@ -182,7 +283,7 @@ MalNode Reader::ReadString() {
 
     std::string value;
 
-    std::string literal_value = token.substr(1, token.size() - 2);
+    std::string_view literal_value = token.substr(1, token.size() - 2);
 
     for(std::size_t index = 0; index < literal_value.size(); index++)
     {
@@ -215,5 +316,148 @@ MalNode Reader::ReadString() {
         value += literal_value[index];
     }
 
-    return std::make_shared<String>(value);
-}
\ No newline at end of file
+    return MalNode::Make<String>(value);
+}
+
+StreamReader::StreamReader(int fd) : buffer_{}, scan_pos_{0}, form_start_{}, depth_{0}, eof_{false} {
+    read_ = [fd](char* buf, std::size_t size) -> std::size_t {
+        while (true) {
+            auto count = ::read(fd, buf, size);
+            if (count >= 0)
+                return static_cast<std::size_t>(count);
+            if (errno != EINTR)
+                throw std::runtime_error(std::string{"read failed: "} + std::strerror(errno));
+        }
+    };
+}
+
+StreamReader::StreamReader(std::istream& in) : buffer_{}, scan_pos_{0}, form_start_{}, depth_{0}, eof_{false} {
+    read_ = [&in](char* buf, std::size_t size) -> std::size_t {
+        in.read(buf, static_cast<std::streamsize>(size));
+        return static_cast<std::size_t>(in.gcount());
+    };
+}
+
+/*
+ * @brief Appends the next chunk of input to the buffer
+ *
+ * @return false once the input is exhausted
+ * */
+bool StreamReader::Fill() {
+    if (eof_)
+        return false;
+
+    auto old_size = buffer_.size();
+    buffer_.resize(old_size + chunk_size);
+
+    auto count = read_(buffer_.data() + old_size, chunk_size);
+    buffer_.resize(old_size + count);
+
+    if (count == 0)
+        eof_ = true;
+
+    return count != 0;
+}
+
+/*
+ * @brief Parses the buffered form ending at end and moves past it
+ *
+ * The bytes read stay in the buffer until the next Fill, erasing them here would move
+ * the rest of the chunk once per form.
+ * */
+MalNode StreamReader::TakeForm(std::size_t end) {
+    auto start = form_start_.value_or(end);
+    Reader r {buffer_.substr(start, end - start)};
+
+    scan_pos_ = end;
+    form_start_.reset();
+    depth_ = 0;
+
+    r.Tokenize();
+    return r.ReadForm();
+}
+
+/*
+ * @brief Reads the next complete top-level form
+ *
+ * Form boundaries are found by scanning tokens and tracking bracket depth, the
+ * complete form is then handed to Reader. Quote prefixes (' ` ~ ~@) belong to
+ * the form that follows them. A form left open at end of input is still passed
+ * to Reader so it reports the error.
+ *
+ * @return AST of the form, or nullopt at end of input
+ * */
+std::optional<MalNode> StreamReader::NextForm() {
+    while (true) {
+        std::string_view buffer {buffer_};
+        Lexer lexer {buffer.substr(scan_pos_)};
+
+        while (true) {
+            auto token = lexer.Next();
+            auto token_start = static_cast<std::size_t>(token.text_.data() - buffer.data());
+            auto token_end = token_start + token.text_.size();
+
+            if (token.kind_ == Token::Kind::End) {
+                scan_pos_ = buffer.size();
+                break;
+            }
+
+            // The token may continue in the next chunk ("~" may become "~@"). A string cut
+            // right after a backslash ends before it, one byte short of the chunk's end.
+            bool may_continue = token.kind_ != Token::Kind::Special || token.text_ == "~";
+            bool cut_at_escape = token.kind_ == Token::Kind::String && token_end + 1 == buffer.size() &&
+                buffer[token_end] == '\\';
+            if (((token_end == buffer.size() && may_continue) || cut_at_escape) && !eof_)
+                break;
+
+            scan_pos_ = token_end;
+
+            if (token.kind_ == Token::Kind::Comment)
+                continue;
+
+            if (!form_start_.has_value())
+                form_start_ = token_start;
+
+            if (token.kind_ == Token::Kind::Special) {
+                switch (token.text_[0]) {
+                    case '(':
+                    case '[':
+                    case '{':
+                        depth_++;
+                        continue;
+                    case ')':
+                    case ']':
+                    case '}':
+                        depth_ = (depth_ > 0) ? depth_ - 1 : 0;
+                        break;
+                    case '\'':
+                    case '`':
+                    case '~':
+                        continue;
+                    default:
+                        break;
+                }
+            }
+
+            if (depth_ == 0)
+                return TakeForm(token_end);
+        }
+
+        // Only the form being read is kept across a Fill, the forms, whitespace and
+        // comments before it are dropped
+        auto keep = form_start_.value_or(scan_pos_);
+        buffer_.erase(0, keep);
+        scan_pos_ -= keep;
+        if (form_start_.has_value())
+            form_start_ = 0;
+
+        if (!Fill()) {
+            if (form_start_.has_value())
+                return TakeForm(buffer_.size());
+
+            buffer_.clear();
+            scan_pos_ = 0;
+            return std::nullopt;
+        }
+    }
+}
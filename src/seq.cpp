@@ -0,0 +1,190 @@
+#include "../include/numeric.h"
+#include "../include/types.h"
+
+#include <stdexcept>
+
+MalNode LazySeq::Thunk(MalNode fn) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Thunk);
+    seq.As<LazySeq>()->fn_ = std::move(fn);
+
+    return seq;
+}
+
+MalNode LazySeq::Range(MalNode start, std::int64_t count, std::int64_t step) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Range);
+    auto lazy = seq.As<LazySeq>();
+    lazy->state_ = std::move(start);
+    lazy->count_ = count;
+    lazy->step_ = step;
+
+    return seq;
+}
+
+MalNode LazySeq::Iterate(MalNode fn, MalNode x) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Iterate);
+    auto lazy = seq.As<LazySeq>();
+    lazy->fn_ = std::move(fn);
+    lazy->state_ = std::move(x);
+
+    return seq;
+}
+
+MalNode LazySeq::Map(MalNode fn, MalNode source, std::size_t offset) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Map);
+    auto lazy = seq.As<LazySeq>();
+    lazy->fn_ = std::move(fn);
+    lazy->source_ = std::move(source);
+    lazy->offset_ = offset;
+
+    return seq;
+}
+
+MalNode LazySeq::Filter(MalNode fn, MalNode source, std::size_t offset) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Filter);
+    auto lazy = seq.As<LazySeq>();
+    lazy->fn_ = std::move(fn);
+    lazy->source_ = std::move(source);
+    lazy->offset_ = offset;
+
+    return seq;
+}
+
+MalNode LazySeq::Take(std::int64_t count, MalNode source, std::size_t offset) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Take);
+    auto lazy = seq.As<LazySeq>();
+    lazy->source_ = std::move(source);
+    lazy->offset_ = offset;
+    lazy->count_ = count;
+
+    return seq;
+}
+
+MalNode LazySeq::Drop(std::int64_t count, MalNode source, std::size_t offset) {
+    auto seq = MalNode::Make<LazySeq>(Kind::Drop);
+    auto lazy = seq.As<LazySeq>();
+    lazy->source_ = std::move(source);
+    lazy->offset_ = offset + static_cast<std::size_t>(count);
+
+    return seq;
+}
+
+MalNode LazySeq::Cons(MalNode x, MalNode seq) {
+    auto cons = MalNode::Make<LazySeq>(Kind::Realized);
+    auto lazy = cons.As<LazySeq>();
+    lazy->chunk_.push_back(std::move(x));
+    lazy->rest_ = std::move(seq);
+
+    return cons;
+}
+
+void LazySeq::Realize() {
+    if (kind_ == Kind::Realized)
+        return;
+
+    // Built aside and kept only once the producer has finished, so a call that throws
+    // leaves the seq unrealized
+    std::vector<MalNode> chunk;
+    MalNode rest;
+    std::vector<MalNode> args;
+
+    switch (kind_) {
+        case Kind::Thunk: {
+            auto seq = ApplyFunction(fn_, args);
+            if (!IsSeq(seq))
+                throw std::logic_error("lazy-seq body must return a sequence!");
+
+            if (seq.Type() == NodeType::LazySeq) {
+                auto lazy = seq.As<LazySeq>();
+                lazy->Realize();
+                chunk = lazy->chunk_;
+                rest = lazy->rest_;
+            } else {
+                rest = std::move(seq);
+            }
+            break;
+        }
+        case Kind::Range: {
+            auto size = (count_ < 0) ? chunk_size : std::min<std::size_t>(chunk_size, static_cast<std::size_t>(count_));
+            auto next = state_;
+            for (std::size_t index = 0; index < size; index++) {
+                chunk.push_back(next);
+
+                // A bounded range stops at its last element, stepping past it could overflow.
+                // An endless one steps through AddNumbers, going on in BigInts past INT64_MAX
+                if (count_ < 0 || index + 1 < static_cast<std::size_t>(count_))
+                    next = AddNumbers(next, MalNode::Int(step_));
+            }
+
+            if (count_ < 0)
+                rest = Range(next, -1, step_);
+            else if (static_cast<std::size_t>(count_) > size)
+                rest = Range(next, count_ - static_cast<std::int64_t>(size), step_);
+            break;
+        }
+        case Kind::Iterate: {
+            auto x = state_;
+            for (std::size_t index = 0; index < chunk_size; index++) {
+                if (index > 0 || count_ == 1) {
+                    args.assign(1, x);
+                    x = ApplyFunction(fn_, args);
+                }
+                chunk.push_back(x);
+            }
+
+            rest = Iterate(fn_, std::move(x));
+            rest.As<LazySeq>()->count_ = 1;
+            break;
+        }
+        case Kind::Map:
+        case Kind::Filter: {
+            SeqCursor cursor {source_, offset_};
+            std::size_t index = 0;
+            for (; index < chunk_size && !cursor.Done(); index++, cursor.Next()) {
+                args.assign(1, cursor.Get());
+                auto value = ApplyFunction(fn_, args);
+
+                if (kind_ == Kind::Map)
+                    chunk.push_back(std::move(value));
+                else if (value.IsTruthy())
+                    chunk.push_back(cursor.Get());
+            }
+
+            // Only a short chunk is known to be the last, checking for more would realize them
+            if (index == chunk_size)
+                rest = (kind_ == Kind::Map) ? Map(fn_, cursor.Seq(), cursor.Offset()) : Filter(fn_, cursor.Seq(), cursor.Offset());
+            break;
+        }
+        case Kind::Take:
+        case Kind::Drop: {
+            SeqCursor cursor {source_, offset_};
+            auto size = (kind_ == Kind::Drop) ? chunk_size : std::min<std::size_t>(chunk_size, static_cast<std::size_t>(count_));
+
+            // A drop that lands on the start of a lazy chunk is the rest of the source as it is
+            if (kind_ == Kind::Drop && !cursor.Done() && cursor.Offset() == 0 && cursor.Seq().Type() == NodeType::LazySeq) {
+                rest = cursor.Seq();
+                break;
+            }
+
+            std::size_t index = 0;
+            for (; index < size && !cursor.Done(); index++, cursor.Next())
+                chunk.push_back(cursor.Get());
+
+            if (index < size)
+                break;
+            if (kind_ == Kind::Drop)
+                rest = Drop(0, cursor.Seq(), cursor.Offset());
+            else if (static_cast<std::size_t>(count_) > size)
+                rest = Take(count_ - static_cast<std::int64_t>(size), cursor.Seq(), cursor.Offset());
+            break;
+        }
+        case Kind::Realized:
+            break;
+    }
+
+    kind_ = Kind::Realized;
+    chunk_ = std::move(chunk);
+    rest_ = std::move(rest);
+    fn_ = MalNode{};
+    source_ = MalNode{};
+    state_ = MalNode{};
+}
@@ -4,6 +4,7 @@
 #include <string>
 
 #include "../include/environment.h"
+#include "../include/numeric.h"
 #include "../include/printer.h"
 #include "../include/reader.h"
 
@@ -38,46 +39,43 @@ MalNode READ(std::string line) {
  * @return Parsed expression
  * */
 MalNode EVAL(MalNode ast, [[ maybe_unused ]] Environment& env) {
-    switch (ast->type_) {
+    switch (ast.Type()) {
         case MalType::NodeType::List: {
-            auto list_node = static_cast<List*>(ast.get());
+            auto list_node = ast.As<List>();
             auto& children = list_node->children_;
 
             if (children.size() == 0)
                 return ast;
 
-            auto symbol = static_cast<Symbol*>(children[0].get());
-            auto func = static_cast<Function*>(env.Get(symbol->symbol_).get());
+            auto func = env.Get(children[0].AsId()).As<Builtin>();
 
             std::vector<MalNode> eval_children;
             for (auto& child : children | std::views::drop(1)) {
                 eval_children.push_back(EVAL(child, env));
             }
 
-            return func->ApplyFn(eval_children);
+            return func->Call(eval_children);
         }
         case MalType::NodeType::Symbol: {
-            auto symbol_node = static_cast<Symbol*>(ast.get());
-
-            auto& symbol = symbol_node->symbol_;
-
-            return env.Get(symbol);
+            return env.Get(ast.AsId());
         }
         case MalType::NodeType::Vector: {
-            auto vector_node = static_cast<Vector*>(ast.get());
+            auto vector_node = MalNode::Make<Vector>();
 
-            for(auto& child : vector_node->children_)
-                child = EVAL(child, env);
+            ast.As<Vector>()->ForEach([&](const MalNode& child) {
+                vector_node.As<Vector>()->Add(EVAL(child, env));
+            });
 
-            return ast;
+            return vector_node;
         }
         case MalType::NodeType::HashMap: {
-            auto hash_map_node = static_cast<HashMap*>(ast.get());
+            auto hash_map_node = MalNode::Make<HashMap>();
 
-            for (auto& [k, child_node] : hash_map_node->kv_)
-                child_node = EVAL(child_node, env);
+            ast.As<HashMap>()->ForEach([&](const MalNode& key, const MalNode& child_node) {
+                hash_map_node.As<HashMap>()->Add(key, EVAL(child_node, env));
+            });
 
-            return ast;
+            return hash_map_node;
         }
         default:
             break;
@@ -95,7 +93,7 @@ std::string PRINT(MalNode ast) {
     return PrintAst(ast);
 }
 
-std::string rep(std::string line, Environment env) {
+std::string rep(std::string line, Environment& env) {
     return PRINT(EVAL(READ(line), env));
 }
 
@@ -104,40 +102,38 @@ std::string rep(std::string line, Environment env) {
  *
  * */
 void InitEnvironment(Environment& env) {
-    env.Set("+", std::make_shared<Function>([](auto& nodes) -> MalNode {
-        auto int_node = std::make_shared<Int>(0);
+    env.Set("+", MalNode::Make<Builtin>("+", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+        auto sum = MalNode::Int(0);
         for (auto& node : nodes)
-            int_node->num_ += static_cast<Int*>(node.get())->num_;
-        return int_node;
+            sum = AddNumbers(sum, node);
+        return sum;
     }));
 
-    env.Set("-", std::make_shared<Function>([](auto& nodes) -> MalNode {
-        auto first_node_val = static_cast<Int*>(nodes[0].get())->num_;
-        auto int_node = std::make_shared<Int>(first_node_val);
+    env.Set("-", MalNode::Make<Builtin>("-", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+        auto difference = nodes[0];
         for (auto& node : nodes | std::views::drop(1))
-            int_node->num_ -= static_cast<Int*>(node.get())->num_;
-        return int_node;
+            difference = SubtractNumbers(difference, node);
+        return difference;
     }));
 
-    env.Set("*", std::make_shared<Function>([](auto& nodes) -> MalNode {
-        auto int_node = std::make_shared<Int>(1);
+    env.Set("*", MalNode::Make<Builtin>("*", 0, Builtin::variadic, [](auto& nodes) -> MalNode {
+        auto product = MalNode::Int(1);
         for (auto& node : nodes)
-            int_node->num_ *= static_cast<Int*>(node.get())->num_;
-        return int_node;
+            product = MultiplyNumbers(product, node);
+        return product;
     }));
 
-    env.Set("/", std::make_shared<Function>([](auto& nodes) -> MalNode {
-        auto first_node_val = static_cast<Int*>(nodes[0].get())->num_;
-        auto int_node = std::make_shared<Int>(first_node_val);
+    env.Set("/", MalNode::Make<Builtin>("/", 1, Builtin::variadic, [](auto& nodes) -> MalNode {
+        auto quotient = nodes[0];
         for (auto& node : nodes | std::views::drop(1))
-            int_node->num_ /= static_cast<Int*>(node.get())->num_;
-        return int_node;
+            quotient = DivideNumbers(quotient, node);
+        return quotient;
     }));
 }
 
 int main() {
-    Environment env;
-    InitEnvironment(env);
+    auto env = MakeGc<Environment>();
+    InitEnvironment(*env);
 
     while (true) {
         std::cout << "user> ";
@@ -149,7 +145,7 @@ int main() {
         std::getline(std::cin, line);
 
         try {
-            std::cout << rep(line, env) << std::endl;
+            std::cout << rep(line, *env) << std::endl;
         } catch( const std::exception& e) {
             std::cout << e.what() << std::endl;
         }
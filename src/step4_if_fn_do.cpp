@@ -1,16 +1,23 @@
+#include <algorithm>
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
 #include <string>
+#include <unordered_map>
+#include <utility>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../include/arena.h"
 #include "../include/core.h"
 #include "../include/environment.h"
 #include "../include/printer.h"
 #include "../include/reader.h"
 #include "../include/repfuncs.h"
 
-std::vector<std::shared_ptr<Environment>> envs;
-
 /*
  * @brief Takes source code and tokenizes + parses it into an AST
  *
@@ -26,7 +33,7 @@ MalNode ReadStr(std::string src) {
 }
 
 /*
- * @brief Takes a line of source and calls ReadStr
+ * @brief Takes a line of source and calls ReadStr, for the forms rep evaluates at startup
  *
  * @param Source code
  * @return AST
@@ -35,81 +42,174 @@ MalNode READ(std::string line) {
     return ReadStr(line);
 }
 
-MalNode Apply(Environment& env, std::vector<MalNode>& children) {
+namespace {
+
+bool MayCapture(const MalNode& form) {
+    switch (form.Type()) {
+        case MalType::NodeType::List: {
+            auto& children = form.As<List>()->children_;
+            return (!children.empty() && children[0].Type() == MalType::NodeType::Symbol &&
+                (children[0].AsId() == SpecialForm::Fn || children[0].AsId() == SpecialForm::LazySeq)) ||
+                std::ranges::any_of(children, MayCapture);
+        }
+        case MalType::NodeType::Vector: {
+            bool captures = false;
+            form.As<Vector>()->ForEach([&](const MalNode& child) { captures = captures || MayCapture(child); });
+            return captures;
+        }
+        case MalType::NodeType::HashMap: {
+            bool captures = false;
+            form.As<HashMap>()->ForEach([&](const MalNode& key, const MalNode& value) {
+                captures = captures || MayCapture(key) || MayCapture(value);
+            });
+            return captures;
+        }
+        default:
+            return false;
+    }
+}
 
-    if (dynamic_cast<Symbol*>(children[0].get())) {
-        auto& symbol = static_cast<Symbol*>(children[0].get())->symbol_;
+/*
+ * @brief Escape analysis: whether a closure made while evaluating forms can capture their frame
+ *
+ * Only fn* and lazy-seq capture the Environment they are evaluated in, so the frame of a
+ * let* or closure call whose forms contain neither is dead when they return, and can live
+ * on the stack.
+ *
+ * @param The forms evaluated in the frame: a let* binding list and body, or a closure body
+ * @return False if the frame can be a StackEnvironment
+ * */
+bool FrameEscapes(const MalNode& form, const MalNode& rest) {
+    if (!form.IsHeap())
+        return MayCapture(rest);
 
-        if (symbol == "def!") {
-            auto variable = static_cast<Symbol*>(children[1].get())->symbol_;
-            auto value = EVAL(children[2], env);
+    // Keyed on form, as rest is the rest of the same let* or nil, so each form is walked
+    // once however often it is evaluated. The entry holds form, so its address is not reused
+    thread_local std::unordered_map<const MalType*, std::pair<MalNode, bool>> cache;
 
-            env.Set(variable, value);
+    auto it = cache.find(form.Get());
+    if (it == cache.end())
+        it = cache.emplace(form.Get(), std::pair{form, MayCapture(form) || MayCapture(rest)}).first;
 
-            return value;
-        } else if (symbol == "let*") {
-            auto current_env = std::make_shared<Environment>(&env);
-            envs.push_back(current_env);
+    return it->second.second;
+}
 
-            auto binding_list = static_cast<List*>(children[1].get())->children_;
+/*
+ * @brief Binds a let* frame's bindings in order, then evaluates its body there
+ * */
+MalNode EvalLet(Environment& frame, std::vector<MalNode>& children) {
+    auto binding_list = (children[1].Type() == MalType::NodeType::Vector) ?
+        children[1].As<Vector>()->Elements() : children[1].As<List>()->children_;
 
-            for(std::size_t i = 0; i < binding_list.size() - 1; i += 2) {
-                auto var = static_cast<Symbol*>(binding_list[i].get())->symbol_;
-                auto val = EVAL(binding_list[i+1], *current_env);
+    for(std::size_t i = 0; i < binding_list.size() - 1; i += 2) {
+        auto var = binding_list[i].AsId();
+        auto val = EVAL(binding_list[i+1], frame);
 
-                current_env->Set(var, val);
-            }
-            return EVAL(children[2], *current_env);
+        frame.Set(var, val);
+    }
+    return EVAL(children[2], frame);
+}
 
-        } else if (symbol == "do") {
-            MalNode ret = nullptr;
-            for (std::size_t i = 1; i < children.size(); i++) {
-                auto eval_child = EVAL(children[i], env);
+/*
+ * @brief Binds a closure's parameters in a new frame and evaluates its body there
+ *
+ * Also registered with SetClosureApply, for the closures builtins call, e.g. a lazy seq's.
+ * */
+MalNode ApplyClosure(const MalNode& callee, std::vector<MalNode>& args) {
+    auto func = callee.As<Closure>();
+
+    // Fixed parameters come before &, which binds the rest of the arguments
+    auto variadic = std::ranges::find(func->binds_, InternId{SpecialForm::Variadic});
+    auto arity = static_cast<std::size_t>(variadic - func->binds_.begin());
+    if (args.size() < arity || (variadic == func->binds_.end() && args.size() != arity))
+        throw std::logic_error("fn*: wrong number of arguments!");
+
+    if (FrameEscapes(func->body_, MalNode::Nil())) {
+        auto new_env = MakeGc<Environment>(func->env_, func->binds_, args);
+        return EVAL(func->body_, *new_env);
+    }
 
-                if ( i == children.size() - 1)
-                    ret = eval_child;
-            }
+    StackEnvironment frame {func->env_, func->binds_, args};
+    return EVAL(func->body_, frame);
+}
 
-            return ret;
-        } else if (symbol == "if") {
-            assert(children.size() == 3 || children.size() == 4);
+} // namespace
 
-            auto eval_condition = EVAL(children[1], env);
+MalNode Apply(Environment& env, std::vector<MalNode>& children) {
 
-            if ( (eval_condition->type_ == MalType::NodeType::Nil) ||
-                 (eval_condition->type_ == MalType::NodeType::Boolean && !static_cast<Boolean*>(eval_condition.get())->b_))
-                return (children.size() == 4) ? EVAL(children[3], env) : std::make_shared<Nil>();
+    if (children[0].Type() == MalType::NodeType::Symbol) {
+        switch (children[0].AsId()) {
+            case SpecialForm::Def: {
+                auto variable = children[1].AsId();
+                auto value = EVAL(children[2], env);
 
-            return EVAL(children[2], env);
-        } else if (symbol == "fn*") {
-            auto fn_vars = static_cast<List*>(children[1].get());
+                env.Set(variable, value);
 
-            std::vector<std::string> binds;
-            for (auto& var : fn_vars->children_) {
-                auto var_symbol = static_cast<Symbol*>(var.get())->symbol_;
-                binds.push_back(var_symbol);
+                return value;
             }
+            case SpecialForm::Let: {
+                if (FrameEscapes(children[1], children[2]))
+                    return EvalLet(*MakeGc<Environment>(&env), children);
 
-            auto fn_body = children[2];
+                StackEnvironment frame {&env};
+                return EvalLet(frame, children);
+            }
+            case SpecialForm::Do: {
+                MalNode ret;
+                for (std::size_t i = 1; i < children.size(); i++) {
+                    auto eval_child = EVAL(children[i], env);
 
-            auto closure = std::make_shared<Function>([binds, fn_body, &env](std::vector<MalNode>& exprs) -> MalNode {
-                auto new_env = std::make_shared<Environment>(&env, binds, exprs);
-                envs.push_back(new_env);
+                    if ( i == children.size() - 1)
+                        ret = eval_child;
+                }
 
-                return EVAL(fn_body, *new_env);
-            });
+                return ret;
+            }
+            case SpecialForm::If: {
+                assert(children.size() == 3 || children.size() == 4);
+
+                auto eval_condition = EVAL(children[1], env);
+
+                if (!eval_condition.IsTruthy())
+                    return (children.size() == 4) ? EVAL(children[3], env) : MalNode::Nil();
+
+                return EVAL(children[2], env);
+            }
+            case SpecialForm::Fn: {
+                auto fn_vars = (children[1].Type() == MalType::NodeType::Vector) ?
+                    children[1].As<Vector>()->Elements() : children[1].As<List>()->children_;
+
+                std::vector<InternId> binds;
+                for (auto& var : fn_vars)
+                    binds.push_back(var.AsId());
+
+                return MalNode::Make<Closure>(std::move(binds), children[2], GcRef<Environment>{&env});
+            }
+            case SpecialForm::LazySeq: {
+                // (lazy-seq body...) is a seq over (fn* () (do body...)), called once when first walked
+                auto body = MalNode::Make<List>();
+                body.As<List>()->children_.assign(children.begin(), children.end());
+                body.As<List>()->children_[0] = MalNode::Symbol(SpecialForm::Do);
 
-            return closure;
+                return LazySeq::Thunk(MalNode::Make<Closure>(std::vector<InternId>{}, body, GcRef<Environment>{&env}));
+            }
+            default:
+                break;
         }
     }
 
     auto node = EVAL(children[0], env);
-    auto func = dynamic_cast<Function*>(node.get());
+    if (!IsFunction(node))
+        throw std::logic_error(node.Print(true) + " is not a function!");
+
     std::vector<MalNode> eval_children;
     for (auto& child : children | std::views::drop(1))
         eval_children.emplace_back(EVAL(child, env));
 
-    return func->ApplyFn(eval_children);
+    if (node.Type() == MalType::NodeType::Builtin)
+        return node.As<Builtin>()->Call(eval_children);
+
+    return ApplyClosure(node, eval_children);
 }
 
 /*
@@ -119,9 +219,9 @@ MalNode Apply(Environment& env, std::vector<MalNode>& children) {
  * @return Parsed expression
  * */
 MalNode EVAL(MalNode ast, Environment& env) {
-    switch (ast->type_) {
+    switch (ast.Type()) {
         case MalType::NodeType::List: {
-            auto list_node = static_cast<List*>(ast.get());
+            auto list_node = ast.As<List>();
 
             auto& children = list_node->children_;
             if (children.size() == 0)
@@ -131,27 +231,25 @@ MalNode EVAL(MalNode ast, Environment& env) {
             return node;
         }
         case MalType::NodeType::Symbol: {
-            auto symbol_node = static_cast<Symbol*>(ast.get());
-
-            auto& symbol = symbol_node->symbol_;
-
-            return env.Get(symbol);
+            return env.Get(ast.AsId());
         }
         case MalType::NodeType::Vector: {
-            auto vector_node = static_cast<Vector*>(ast.get());
+            auto vector_node = MalNode::Make<Vector>();
 
-            for(auto& child : vector_node->children_)
-                child = EVAL(child, env);
+            ast.As<Vector>()->ForEach([&](const MalNode& child) {
+                vector_node.As<Vector>()->Add(EVAL(child, env));
+            });
 
-            return ast;
+            return vector_node;
         }
         case MalType::NodeType::HashMap: {
-            auto hash_map_node = static_cast<HashMap*>(ast.get());
+            auto hash_map_node = MalNode::Make<HashMap>();
 
-            for (auto& [k, child_node] : hash_map_node->kv_)
-                child_node = EVAL(child_node, env);
+            ast.As<HashMap>()->ForEach([&](const MalNode& key, const MalNode& child_node) {
+                hash_map_node.As<HashMap>()->Add(key, EVAL(child_node, env));
+            });
 
-            return ast;
+            return hash_map_node;
         }
         default:
             break;
@@ -177,6 +275,7 @@ std::string rep(std::string line, Environment& env) {
  *
  * */
 void InitEnvironment(Environment& env) {
+    SetClosureApply(ApplyClosure);
     rep("(def! not (fn* (a) (if a false true)))", env);
     Core c;
 
@@ -185,24 +284,61 @@ void InitEnvironment(Environment& env) {
     }
 }
 
-int main() {
+/*
+ * @brief Evaluates every form streamed from a file, or from stdin when path is "-"
+ *
+ * @param Path to the source file and Environment
+ * @return Process exit status
+ * */
+int RunFile(std::string path, Environment& env) {
+    int fd = (path == "-") ? STDIN_FILENO : ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << path << ": " << std::strerror(errno) << std::endl;
+        return 1;
+    }
 
-    Environment env;
-    InitEnvironment(env);
+    int status = 0;
+    StreamReader reader {fd};
 
-    while (true) {
-        std::cout << "user> ";
+    try {
+        while (auto form = reader.NextForm())
+            EVAL(form.value(), env);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        status = 1;
+    }
 
-        if (std::cin.eof())
-            std::exit(1);
+    if (fd != STDIN_FILENO)
+        ::close(fd);
+
+    return status;
+}
 
-        std::string line;
-        std::getline(std::cin, line);
+int main(int argc, char** argv) {
+
+    auto env = MakeGc<Environment>();
+    InitEnvironment(*env);
+
+    if (argc > 1)
+        return RunFile(argv[1], *env);
+
+    // Forms are read as they complete, so one may span lines and several may share one
+    StreamReader reader {STDIN_FILENO};
+
+    while (true) {
+        std::cout << "user> " << std::flush;
 
         try {
-            std::cout << rep(line, env) << std::endl;
+            auto form = reader.NextForm();
+            if (!form.has_value())
+                return 1;
+
+            std::cout << PRINT(EVAL(form.value(), *env)) << std::endl;
         } catch( const std::exception& e) {
             std::cout << e.what() << std::endl;
         }
+
+        // What the evaluation left behind is free by now, so wholly unused blocks go back
+        Arena::Instance().Trim();
     }
 }
@@ -1,236 +1,861 @@
 #include "../include/types.h"
+#include "../include/environment.h"
+
+#include <bit>
+#include <charconv>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+
+/*
+ * @brief Whether two memoized hashes prove their values unequal, which needs both computed
+ * */
+bool HashesDiffer(std::size_t hash, std::size_t other_hash) {
+    return hash != 0 && other_hash != 0 && hash != other_hash;
+}
+
+} // namespace
 
 void List::Add(MalNode node) {
     children_.push_back(node);
+    hash_ = 0;
 }
 
-std::string List::Print(bool print_readably) {
-    std::stringstream ss;
+void List::Trace(GcVisitor& visitor) {
+    for (auto& child : children_)
+        TraceNode(visitor, child);
+}
+
+void List::Clear() {
+    children_.clear();
+    hash_ = 0;
+}
 
-    ss << "(";
+void List::PrintTo(std::string& out, bool print_readably) {
+    out += '(';
     for (size_t index = 0;auto& child : children_) {
-        ss << child->Print(print_readably);
+        child.PrintTo(out, print_readably);
 
         index++;
 
         if (index != children_.size())
-            ss << " ";
+            out += ' ';
     }
-    ss << ")";
-
-    return ss.str();
+    out += ')';
 }
 
 bool List::operator==(MalType& other) {
-    if (other.type_ != NodeType::List && other.type_ != NodeType::Vector)
+    if (other.type_ == NodeType::Vector)
+        return static_cast<Vector*>(&other)->operator==(*this);
+    if (other.type_ == NodeType::LazySeq)
+        return static_cast<LazySeq*>(&other)->operator==(*this);
+    if (other.type_ != NodeType::List)
         return false;
 
-    auto other_list_children = (other.type_ != NodeType::Vector) ? static_cast<Vector*>(&other)->children_ : static_cast<List*>(&other)->children_;
-    if (other_list_children .size() != children_.size())
+    auto other_list = static_cast<List*>(&other);
+    auto& other_children = other_list->children_;
+    if (other_children.size() != children_.size() || HashesDiffer(hash_, other_list->hash_))
         return false;
 
     for (std::size_t index = 0; index < children_.size(); index++) {
-        if (! (*children_[index] == *other_list_children [index]))
+        if (! (children_[index] == other_children[index]))
+            return false;
+    }
+
+    return true;
+}
+
+namespace {
+
+/*
+ * @brief Spreads the bits of a hash (the splitmix64 finalizer)
+ * */
+std::size_t MixHash(std::uint64_t hash) {
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ULL;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebULL;
+    hash ^= hash >> 31;
+
+    return static_cast<std::size_t>(hash);
+}
+
+/*
+ * @brief Hash of a list or vector, the same for both so that equal sequences hash alike
+ *
+ * @param Function calling its argument on each element in order
+ * */
+template<typename ForEachElement>
+std::size_t SequenceHash(ForEachElement&& for_each) {
+    std::size_t hash = 1;
+    for_each([&](const MalNode& element) { hash = hash * 31 + element.Hash(); });
+
+    return MixHash(hash);
+}
+
+/*
+ * @brief The node in slot, copied first if anything else references it, so it can be changed in place
+ * */
+template<typename Node>
+Node* Writable(GcRef<GcObject>& slot) {
+    if (!slot) {
+        slot = GcRef<GcObject>{MakeGc<Node>().get()};
+    } else if (slot->refcount_ > 1) {
+        auto copy = MakeGc<Node>();
+        copy->CopyFrom(*static_cast<Node*>(slot.get()));
+        slot = GcRef<GcObject>{copy.get()};
+    }
+
+    return static_cast<Node*>(slot.get());
+}
+
+} // namespace
+
+std::size_t List::Hash() {
+    if (hash_ == 0) {
+        hash_ = SequenceHash([&](auto&& f) {
+            for (auto& child : children_)
+                f(child);
+        });
+    }
+
+    return hash_;
+}
+
+void VectorLeaf::Trace(GcVisitor& visitor) {
+    for (auto& value : values_)
+        TraceNode(visitor, value);
+}
+
+void VectorLeaf::Clear() {
+    values_.fill(MalNode{});
+}
+
+void VectorBranch::Trace(GcVisitor& visitor) {
+    for (auto& child : children_)
+        if (child)
+            visitor.Visit(child.get());
+}
+
+void VectorBranch::Clear() {
+    children_.fill(GcRef<GcObject>{});
+}
+
+MalNode Vector::Copy() const {
+    auto copy_node = MalNode::Make<Vector>();
+    auto copy = copy_node.As<Vector>();
+
+    copy->root_ = root_;
+    copy->tail_ = tail_;
+    copy->shift_ = shift_;
+    copy->tail_offset_ = tail_offset_;
+    copy->start_ = start_;
+    copy->end_ = end_;
+
+    return copy_node;
+}
+
+void Vector::Set(std::size_t index, MalNode node) {
+    if (index >= tail_offset_) {
+        Writable<VectorLeaf>(tail_)->values_[index - tail_offset_] = std::move(node);
+        return;
+    }
+
+    auto slot = &root_;
+    for (auto level = shift_; level > 0; level -= bits)
+        slot = &Writable<VectorBranch>(*slot)->children_[(index >> level) & mask];
+
+    Writable<VectorLeaf>(*slot)->values_[index & mask] = std::move(node);
+}
+
+void Vector::PushTail() {
+    // The trie is full at this height, the old root becomes the first child of a new one
+    if (root_ && (tail_offset_ >> bits) >= (std::size_t{1} << shift_)) {
+        auto new_root = MakeGc<VectorBranch>();
+        new_root->children_[0] = std::move(root_);
+        root_ = GcRef<GcObject>{new_root.get()};
+        shift_ += bits;
+    }
+
+    auto slot = &root_;
+    for (auto level = shift_; level > 0; level -= bits)
+        slot = &Writable<VectorBranch>(*slot)->children_[(tail_offset_ >> level) & mask];
+
+    *slot = std::move(tail_);
+    tail_offset_ += width;
+}
+
+void Vector::Push(MalNode node) {
+    // A subvec can end inside the trie, the next elements then overwrite the ones it dropped
+    if (end_ < tail_offset_) {
+        Set(end_++, std::move(node));
+        return;
+    }
+
+    if (end_ - tail_offset_ == width)
+        PushTail();
+
+    Set(end_++, std::move(node));
+}
+
+void Vector::Add(MalNode node) {
+    Push(std::move(node));
+    hash_ = 0;
+}
+
+void Vector::Replace(std::size_t index, MalNode node) {
+    if (index == Size()) {
+        Add(std::move(node));
+        return;
+    }
+    if (index > Size())
+        throw std::logic_error("index out of bounds!");
+
+    Set(start_ + index, std::move(node));
+    hash_ = 0;
+}
+
+MalNode Vector::Transient() const {
+    auto result = Copy();
+    result.As<Vector>()->transient_ = true;
+
+    return result;
+}
+
+MalNode Vector::Conj(MalNode node) const {
+    auto result = Copy();
+    result.As<Vector>()->Push(std::move(node));
+
+    return result;
+}
+
+MalNode Vector::Assoc(std::size_t index, MalNode node) const {
+    if (index == Size())
+        return Conj(std::move(node));
+    if (index > Size())
+        throw std::logic_error("index out of bounds!");
+
+    auto result = Copy();
+    result.As<Vector>()->Set(start_ + index, std::move(node));
+
+    return result;
+}
+
+MalNode Vector::Subvec(std::size_t start, std::size_t end) const {
+    if (start > end || end > Size())
+        throw std::logic_error("index out of bounds!");
+
+    auto result = Copy();
+    auto vector = result.As<Vector>();
+    vector->start_ = start_ + start;
+    vector->end_ = start_ + end;
+
+    return result;
+}
+
+std::vector<MalNode> Vector::Elements() const {
+    std::vector<MalNode> elements;
+    elements.reserve(Size());
+    ForEach([&](const MalNode& element) { elements.push_back(element); });
+
+    return elements;
+}
+
+namespace {
+
+/*
+ * @brief Whether two trie nodes at the same level hold equal elements at indices [from, to)
+ *
+ * @param Nodes, their level (0 for a leaf) and the index of their first element
+ * */
+bool EqualTrieNodes(const GcObject* node, const GcObject* other, unsigned level, std::size_t base, std::size_t from, std::size_t to) {
+    // Nodes shared by both vectors, e.g. all but one path after an assoc, are not walked
+    if (node == other)
+        return true;
+
+    if (level == 0) {
+        auto& values = static_cast<const VectorLeaf*>(node)->values_;
+        auto& other_values = static_cast<const VectorLeaf*>(other)->values_;
+
+        for (auto index = std::max(from, base); index < std::min(to, base + Vector::width); index++)
+            if (! (values[index & Vector::mask] == other_values[index & Vector::mask]))
+                return false;
+
+        return true;
+    }
+
+    auto& children = static_cast<const VectorBranch*>(node)->children_;
+    auto& other_children = static_cast<const VectorBranch*>(other)->children_;
+    auto span = std::size_t{1} << level;
+
+    for (std::size_t slot = 0; slot < Vector::width; slot++) {
+        auto child_base = base + slot * span;
+        if (child_base >= to)
+            break;
+        if (child_base + span <= from)
+            continue;
+
+        if (!EqualTrieNodes(children[slot].get(), other_children[slot].get(), level - Vector::bits, child_base, from, to))
             return false;
     }
 
     return true;
 }
 
+} // namespace
+
+/*
+ * @brief Whether other keeps its elements at the same positions, so the tries can be compared node by node
+ * */
+bool Vector::SameLayout(const Vector& other) const {
+    return start_ == other.start_ && end_ == other.end_ && shift_ == other.shift_ && tail_offset_ == other.tail_offset_;
+}
+
 bool Vector::operator==(MalType& other) {
-    if (other.type_ != NodeType::List && other.type_ != NodeType::Vector)
+    if (other.type_ == NodeType::LazySeq)
+        return static_cast<LazySeq*>(&other)->operator==(*this);
+    if (other.type_ == NodeType::List) {
+        auto other_list = static_cast<List*>(&other);
+        auto& other_children = other_list->children_;
+        if (other_children.size() != Size() || HashesDiffer(hash_, other_list->hash_))
+            return false;
+
+        for (std::size_t index = 0; index < other_children.size(); index++) {
+            if (! (Nth(index) == other_children[index]))
+                return false;
+        }
+
+        return true;
+    }
+    if (other.type_ != NodeType::Vector)
         return false;
 
-    auto other_list_children = (other.type_ != NodeType::Vector) ? static_cast<Vector*>(&other)->children_ : static_cast<List*>(&other)->children_;
-    if (other_list_children.size() != children_.size())
+    auto other_vector = static_cast<Vector*>(&other);
+    if (other_vector->Size() != Size() || HashesDiffer(hash_, other_vector->hash_))
         return false;
 
-    for (std::size_t index = 0; index < children_.size(); index++) {
-        if (! (*children_[index] == *other_list_children[index]))
+    if (SameLayout(*other_vector)) {
+        if (start_ < tail_offset_ && !EqualTrieNodes(root_.get(), other_vector->root_.get(), shift_, 0, start_, std::min(end_, tail_offset_)))
+            return false;
+
+        return end_ <= tail_offset_ || EqualTrieNodes(tail_.get(), other_vector->tail_.get(), 0, tail_offset_, std::max(start_, tail_offset_), end_);
+    }
+
+    for (std::size_t index = 0; index < Size(); index++) {
+        if (! (Nth(index) == other_vector->Nth(index)))
             return false;
     }
 
     return true;
 }
 
-void Vector::Add(MalNode node) {
-    children_.push_back(node);
+std::size_t Vector::Hash() {
+    if (hash_ == 0)
+        hash_ = SequenceHash([&](auto&& f) { ForEach(f); });
+
+    return hash_;
 }
 
-std::string Vector::Print(bool print_readably) {
-    std::stringstream ss;
+void Vector::Trace(GcVisitor& visitor) {
+    if (root_)
+        visitor.Visit(root_.get());
+    if (tail_)
+        visitor.Visit(tail_.get());
+}
 
-    ss << "[";
-    for (size_t index = 0;auto& child : children_) {
-        ss << child->Print(print_readably);
+void Vector::Clear() {
+    root_.reset();
+    tail_.reset();
+    start_ = end_ = tail_offset_ = 0;
+    shift_ = bits;
+    hash_ = 0;
+}
 
-        index++;
+void Vector::PrintTo(std::string& out, bool print_readably) {
+    out += '[';
+    ForEach([&, index = std::size_t{0}](const MalNode& element) mutable {
+        if (index++ != 0)
+            out += ' ';
 
-        if (index != children_.size())
-        ss << " ";
+        element.PrintTo(out, print_readably);
+    });
+    out += ']';
+}
+
+namespace {
+
+constexpr unsigned hash_bits = 5;
+constexpr unsigned hash_levels_end = 64;
+
+std::uint32_t HashBit(std::size_t hash, unsigned shift) {
+    return std::uint32_t{1} << ((hash >> shift) & 31);
+}
+
+/*
+ * @brief Position of bit's slot among the occupied slots of map
+ * */
+std::size_t SlotIndex(std::uint32_t map, std::uint32_t bit) {
+    return static_cast<std::size_t>(std::popcount(map & (bit - 1)));
+}
+
+/*
+ * @brief Value bound to key in the trie under node, a node at level shift, or nullptr
+ * */
+const MalNode* FindEntry(const HashMapNode* node, std::size_t hash, const MalNode& key, unsigned shift = 0) {
+    for (; shift < hash_levels_end; shift += hash_bits) {
+        auto bit = HashBit(hash, shift);
+
+        if (node->entry_map_ & bit) {
+            auto& entry = node->entries_[SlotIndex(node->entry_map_, bit)];
+            return (entry.hash_ == hash && entry.key_ == key) ? &entry.value_ : nullptr;
         }
-    ss << "]";
+        if (!(node->node_map_ & bit))
+            return nullptr;
 
-    return ss.str();
+        node = static_cast<const HashMapNode*>(node->children_[SlotIndex(node->node_map_, bit)].get());
+    }
+
+    for (auto& entry : node->entries_)
+        if (entry.hash_ == hash && entry.key_ == key)
+            return &entry.value_;
+
+    return nullptr;
 }
 
-std::string HashMap::Print(bool print_readably) {
-    std::stringstream ss;
+/*
+ * @brief Binds key in the trie under slot, copying the nodes on the way that are shared
+ *
+ * @return True if key was not bound before
+ * */
+bool InsertEntry(GcRef<GcObject>& slot, std::size_t hash, MalNode key, MalNode value, unsigned shift) {
+    auto node = Writable<HashMapNode>(slot);
+
+    if (shift >= hash_levels_end) {
+        for (auto& entry : node->entries_) {
+            if (entry.hash_ == hash && entry.key_ == key) {
+                entry.value_ = std::move(value);
+                return false;
+            }
+        }
 
-    ss << "{";
-    for (size_t index = 0; auto& [k, v] : kv_) {
-        ss << k << " " <<  v->Print(print_readably);
+        node->entries_.push_back(HashMapNode::Entry{hash, std::move(key), std::move(value)});
+        return true;
+    }
 
-        index++;
+    auto bit = HashBit(hash, shift);
+
+    if (node->entry_map_ & bit) {
+        auto index = SlotIndex(node->entry_map_, bit);
+        auto& entry = node->entries_[index];
+        if (entry.hash_ == hash && entry.key_ == key) {
+            entry.value_ = std::move(value);
+            return false;
+        }
 
-        if (index != kv_.size())
-        ss << " ";
+        // Two keys share this slot, they move down into a new node
+        GcRef<GcObject> child;
+        InsertEntry(child, entry.hash_, std::move(entry.key_), std::move(entry.value_), shift + hash_bits);
+        InsertEntry(child, hash, std::move(key), std::move(value), shift + hash_bits);
+
+        node->entries_.erase(node->entries_.begin() + static_cast<std::ptrdiff_t>(index));
+        node->entry_map_ ^= bit;
+        node->node_map_ |= bit;
+        node->children_.insert(node->children_.begin() + static_cast<std::ptrdiff_t>(SlotIndex(node->node_map_, bit)), std::move(child));
+        return true;
     }
-    ss << "}";
 
-    return ss.str();
+    if (node->node_map_ & bit)
+        return InsertEntry(node->children_[SlotIndex(node->node_map_, bit)], hash, std::move(key), std::move(value), shift + hash_bits);
+
+    node->entry_map_ |= bit;
+    node->entries_.insert(node->entries_.begin() + static_cast<std::ptrdiff_t>(SlotIndex(node->entry_map_, bit)),
+                          HashMapNode::Entry{hash, std::move(key), std::move(value)});
+    return true;
 }
 
-bool HashMap::operator==(MalType& other) {
-    if (other.type_ != type_)
-        return false;
+/*
+ * @brief Unbinds key, which must be bound, from the trie under slot
+ *
+ * A child left with a single entry is folded back into its parent, so every map with
+ * the same keys has the same shape.
+ * */
+void RemoveEntry(GcRef<GcObject>& slot, std::size_t hash, const MalNode& key, unsigned shift) {
+    auto node = Writable<HashMapNode>(slot);
+
+    if (shift >= hash_levels_end) {
+        std::erase_if(node->entries_, [&](auto& entry) { return entry.hash_ == hash && entry.key_ == key; });
+        return;
+    }
 
-    auto other_map = static_cast<HashMap*>(&other);
-    if (other_map->kv_.size() != other_map->kv_.size())
-        return false;
+    auto bit = HashBit(hash, shift);
+
+    if (node->entry_map_ & bit) {
+        node->entries_.erase(node->entries_.begin() + static_cast<std::ptrdiff_t>(SlotIndex(node->entry_map_, bit)));
+        node->entry_map_ ^= bit;
+        return;
+    }
+
+    auto index = SlotIndex(node->node_map_, bit);
+    RemoveEntry(node->children_[index], hash, key, shift + hash_bits);
 
-    for (auto& [k, v] : kv_) {
-        if (other_map->kv_.count(k) == 0)
+    auto child = static_cast<HashMapNode*>(node->children_[index].get());
+    if (child->children_.empty() && child->entries_.size() == 1) {
+        auto entry = std::move(child->entries_.front());
+
+        node->children_.erase(node->children_.begin() + static_cast<std::ptrdiff_t>(index));
+        node->node_map_ ^= bit;
+        node->entry_map_ |= bit;
+        node->entries_.insert(node->entries_.begin() + static_cast<std::ptrdiff_t>(SlotIndex(node->entry_map_, bit)), std::move(entry));
+    }
+}
+
+/*
+ * @brief Whether every entry under node is bound to an equal value under other, the node
+ * at the same position of another map
+ *
+ * Maps of the same size are equal when one contains the entries of the other. Nodes
+ * shared by both maps hold the same entries, so they are not walked.
+ * */
+bool ContainsEntries(const HashMapNode* node, const HashMapNode* other, unsigned shift) {
+    if (node == other)
+        return true;
+
+    auto contains = [&](std::size_t hash, const MalNode& key, const MalNode& value) {
+        auto other_value = FindEntry(other, hash, key, shift);
+        return other_value != nullptr && *other_value == value;
+    };
+
+    for (auto& entry : node->entries_)
+        if (!contains(entry.hash_, entry.key_, entry.value_))
             return false;
-        if(! (other_map->kv_[k] == v))
+
+    for (auto map = node->node_map_; map != 0; map &= map - 1) {
+        auto bit = map & (~map + 1);
+        auto child = static_cast<const HashMapNode*>(node->children_[SlotIndex(node->node_map_, bit)].get());
+
+        if (other->node_map_ & bit) {
+            auto other_child = static_cast<const HashMapNode*>(other->children_[SlotIndex(other->node_map_, bit)].get());
+            if (!ContainsEntries(child, other_child, shift + hash_bits))
+                return false;
+            continue;
+        }
+
+        bool equal = true;
+        auto check = [&](const MalNode& key, const MalNode& value) { equal = equal && contains(key.Hash(), key, value); };
+        child->ForEach(check);
+        if (!equal)
             return false;
     }
 
     return true;
 }
 
+} // namespace
+
+void HashMapNode::Trace(GcVisitor& visitor) {
+    for (auto& entry : entries_) {
+        TraceNode(visitor, entry.key_);
+        TraceNode(visitor, entry.value_);
+    }
+    for (auto& child : children_)
+        visitor.Visit(child.get());
+}
+
+void HashMapNode::Clear() {
+    entries_.clear();
+    children_.clear();
+    entry_map_ = node_map_ = 0;
+}
 
-std::string Int::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+MalNode HashMap::Copy() const {
+    auto copy_node = MalNode::Make<HashMap>();
+    auto copy = copy_node.As<HashMap>();
 
-    ss << num_;
+    copy->root_ = root_;
+    copy->size_ = size_;
 
-    return ss.str();
+    return copy_node;
 }
 
-bool Int::operator==(MalType& other) {
-    if (other.type_ != type_)
-        return false;
+const MalNode* HashMap::Find(const MalNode& key) const {
+    if (!root_)
+        return nullptr;
 
-    return num_ == static_cast<Int*>(&other)->num_;
+    return FindEntry(static_cast<const HashMapNode*>(root_.get()), key.Hash(), key);
 }
 
-std::string Double::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+void HashMap::Add(MalNode key, MalNode value) {
+    auto hash = key.Hash();
+    if (InsertEntry(root_, hash, std::move(key), std::move(value), 0))
+        size_++;
+    hash_ = 0;
+}
 
-    ss << num_;
+MalNode HashMap::Assoc(MalNode key, MalNode value) const {
+    auto result = Copy();
+    result.As<HashMap>()->Add(std::move(key), std::move(value));
 
-    return ss.str();
+    return result;
 }
 
-bool Double::operator==(MalType& other) {
-    if (other.type_ != type_)
-        return false;
+void HashMap::Remove(const MalNode& key) {
+    if (Find(key) == nullptr)
+        return;
 
-    return num_ == static_cast<Double*>(&other)->num_;
+    RemoveEntry(root_, key.Hash(), key, 0);
+    if (--size_ == 0)
+        root_.reset();
+    hash_ = 0;
 }
 
-std::string Keyword::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+MalNode HashMap::Transient() const {
+    auto result = Copy();
+    result.As<HashMap>()->transient_ = true;
 
-    ss << ":";
-    ss << keyword_;
+    return result;
+}
+
+MalNode HashMap::Dissoc(const MalNode& key) const {
+    auto result = Copy();
+    result.As<HashMap>()->Remove(key);
 
-    return ss.str();
+    return result;
 }
 
-bool Keyword::operator==(MalType& other) {
+void HashMap::PrintTo(std::string& out, bool print_readably) {
+    out += '{';
+    ForEach([&, index = std::size_t{0}](const MalNode& key, const MalNode& value) mutable {
+        if (index++ != 0)
+            out += ' ';
+
+        key.PrintTo(out, print_readably);
+        out += ' ';
+        value.PrintTo(out, print_readably);
+    });
+    out += '}';
+}
+
+void HashMap::Trace(GcVisitor& visitor) {
+    if (root_)
+        visitor.Visit(root_.get());
+}
+
+void HashMap::Clear() {
+    root_.reset();
+    size_ = 0;
+    hash_ = 0;
+}
+
+bool HashMap::operator==(MalType& other) {
     if (other.type_ != type_)
         return false;
 
-    return keyword_ == static_cast<Keyword*>(&other)->keyword_;
-}
+    auto other_map = static_cast<HashMap*>(&other);
+    if (other_map->Size() != Size() || HashesDiffer(hash_, other_map->hash_))
+        return false;
+    if (Size() == 0)
+        return true;
 
-std::string String::PrintStr(bool print_readably) {
-    std::stringstream ss;
+    return ContainsEntries(static_cast<const HashMapNode*>(root_.get()), static_cast<const HashMapNode*>(other_map->root_.get()), 0);
+}
 
-    for (std::size_t index = 0; index < s_.size(); index++) {
-        if (print_readably && s_[index] == '\"')
-            ss << '\\' << '\"';
-        else if (print_readably && s_[index] == '\n')
-            ss << '\\' << 'n';
-        else if (print_readably && s_[index] == '\\')
-            ss << '\\' << '\\';
-        else
-            ss << s_[index];
+std::size_t HashMap::Hash() {
+    if (hash_ == 0) {
+        // Independent of the order entries are visited in
+        std::size_t hash = 0;
+        ForEach([&](const MalNode& key, const MalNode& value) { hash += key.Hash() ^ MixHash(value.Hash()); });
+        hash_ = MixHash(hash);
     }
 
-    return ss.str();
+    return hash_;
 }
 
-std::string String::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
-    if (print_readably)
-        ss << "\"";
+namespace {
 
-    ss << PrintStr(print_readably);
+std::uint8_t Height(const MalNode& node) {
+    return node.As<String>()->height_;
+}
 
-    if (print_readably)
-        ss << "\"";
+MalNode MakeRope(MalNode left, MalNode right) {
+    return MalNode::Make<String>(std::move(left), std::move(right));
+}
 
-    return ss.str();
+MalNode RotateLeft(const MalNode& node) {
+    auto rope = node.As<String>();
+    auto right = rope->right_.As<String>();
+    return MakeRope(MakeRope(rope->left_, right->left_), right->right_);
 }
 
-bool String::operator==(MalType& other) {
-    if (other.type_ != type_)
-    return false;
+MalNode RotateRight(const MalNode& node) {
+    auto rope = node.As<String>();
+    auto left = rope->left_.As<String>();
+    return MakeRope(left->left_, MakeRope(left->right_, rope->right_));
+}
+
+/*
+ * @brief Joins two balanced ropes into a balanced rope, as an AVL join
+ *
+ * The shorter rope is hung off the taller one's spine at a node of about its own
+ * height, and the path back up is rotated where it leans by more than one level.
+ * */
+MalNode Join(const MalNode& left, const MalNode& right) {
+    auto left_height = Height(left);
+    auto right_height = Height(right);
+
+    if (left_height > right_height + 1) {
+        auto rope = left.As<String>();
+        auto joined = Join(rope->right_, right);
+        if (Height(joined) <= Height(rope->left_) + 1)
+            return MakeRope(rope->left_, joined);
+
+        if (Height(joined.As<String>()->left_) > Height(joined.As<String>()->right_))
+            joined = RotateRight(joined);
+        return RotateLeft(MakeRope(rope->left_, joined));
+    }
+
+    if (right_height > left_height + 1) {
+        auto rope = right.As<String>();
+        auto joined = Join(left, rope->left_);
+        if (Height(joined) <= Height(rope->right_) + 1)
+            return MakeRope(joined, rope->right_);
+
+        if (Height(joined.As<String>()->right_) > Height(joined.As<String>()->left_))
+            joined = RotateLeft(joined);
+        return RotateRight(MakeRope(joined, rope->right_));
+    }
+
+    return MakeRope(left, right);
+}
+
+/*
+ * @brief The characters [start, end) of node, or node itself when that is all of it
+ * */
+MalNode Slice(const MalNode& node, std::size_t start, std::size_t end) {
+    auto string = node.As<String>();
+    if (start == 0 && end == string->Size())
+        return node;
 
-    return s_ == static_cast<String*>(&other)->s_;
+    return string->Substring(start, end);
 }
 
-std::string Boolean::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+void AppendRange(const String& string, std::string& out, std::size_t start, std::size_t end) {
+    if (!string.IsRope() || !string.s_.empty()) {
+        out.append(string.s_, start, end - start);
+        return;
+    }
 
-    ss << ((b_) ? "true" : "false");
+    auto left = string.left_.As<String>();
+    auto left_size = left->Size();
+    if (start < left_size)
+        AppendRange(*left, out, start, std::min(end, left_size));
+    if (end > left_size)
+        AppendRange(*string.right_.As<String>(), out, std::max(start, left_size) - left_size, end - left_size);
+}
 
-    return ss.str();
+void AppendEscaped(std::string& out, const std::string& s) {
+    for (auto c : s) {
+        if (c == '"')
+            out += "\\\"";
+        else if (c == '\n')
+            out += "\\n";
+        else if (c == '\\')
+            out += "\\\\";
+        else
+            out += c;
+    }
 }
 
-bool Boolean::operator==(MalType& other) {
-    if (other.type_ != type_)
-    return false;
+} // namespace
 
-    return b_ == static_cast<Boolean*>(&other)->b_;
+String::String(MalNode left, MalNode right)
+    : MalType{NodeType::String, false}, s_{}, left_{std::move(left)}, right_{std::move(right)}, size_{0}, height_{0} {
+    size_ = left_.As<String>()->Size() + right_.As<String>()->Size();
+    height_ = std::max(Height(left_), Height(right_)) + 1;
 }
 
-std::string Symbol::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+const std::string& String::Flat() {
+    if (IsRope() && s_.empty()) {
+        s_.reserve(size_);
+        ForEachChunk([&](const std::string& chunk) { s_ += chunk; });
+    }
 
-    ss << symbol_;
+    return s_;
+}
+
+MalNode String::Concat(const MalNode& left, const MalNode& right) {
+    auto left_string = left.As<String>();
+    auto right_string = right.As<String>();
+    if (left_string->Size() == 0)
+        return right;
+    if (right_string->Size() == 0)
+        return left;
+
+    if (left_string->Size() + right_string->Size() <= leaf_size) {
+        std::string s;
+        s.reserve(left_string->Size() + right_string->Size());
+        left_string->ForEachChunk([&](const std::string& chunk) { s += chunk; });
+        right_string->ForEachChunk([&](const std::string& chunk) { s += chunk; });
+        return MalNode::Make<String>(std::move(s));
+    }
+
+    // Appending a short piece to a rope ending in a short leaf grows that leaf instead of
+    // adding one, so building a string a piece at a time keeps leaves near leaf_size
+    if (left_string->IsRope() && !right_string->IsRope()) {
+        auto& last = left_string->right_;
+        if (!last.As<String>()->IsRope() && last.As<String>()->Size() + right_string->Size() <= leaf_size)
+            return Join(left_string->left_, Concat(last, right));
+    }
 
-    return ss.str();
+    return Join(left, right);
 }
 
-bool Symbol::operator==(MalType& other) {
-    if (other.type_ != type_)
-    return false;
+MalNode String::Substring(std::size_t start, std::size_t end) const {
+    assert(start <= end && end <= size_);
+
+    if (!IsRope() || end - start <= leaf_size) {
+        std::string s;
+        s.reserve(end - start);
+        AppendRange(*this, s, start, end);
+        return MalNode::Make<String>(std::move(s));
+    }
 
-    return symbol_ == static_cast<Symbol*>(&other)->symbol_;
+    auto left_size = left_.As<String>()->Size();
+    if (end <= left_size)
+        return Slice(left_, start, end);
+    if (start >= left_size)
+        return Slice(right_, start - left_size, end - left_size);
+
+    return Concat(Slice(left_, start, left_size), Slice(right_, 0, end - left_size));
+}
+
+void String::PrintTo(std::string& out, bool print_readably) {
+    if (!print_readably) {
+        out.reserve(out.size() + size_);
+        ForEachChunk([&](const std::string& chunk) { out += chunk; });
+        return;
+    }
+
+    out += '"';
+    ForEachChunk([&](const std::string& chunk) { AppendEscaped(out, chunk); });
+    out += '"';
 }
 
-std::string Quote::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+bool String::operator==(MalType& other) {
+    if (other.type_ != type_)
+    return false;
+
+    auto other_string = static_cast<String*>(&other);
+    if (other_string->Size() != Size())
+        return false;
 
-    ss << "(quote ";
-    ss << child_->Print(print_readably);
-    ss << ")";
+    return Flat() == other_string->Flat();
+}
 
-    return ss.str();
+void Quote::PrintTo(std::string& out, bool print_readably) {
+    out += "(quote ";
+    child_.PrintTo(out, print_readably);
+    out += ')';
 }
 
 bool Quote::operator==(MalType& other) {
@@ -240,14 +865,10 @@ bool Quote::operator==(MalType& other) {
     return child_ == static_cast<Quote*>(&other)->child_;
 }
 
-std::string Quasiquote::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
-
-    ss << "(quasiquote ";
-    ss << child_->Print(print_readably);
-    ss << ")";
-
-    return ss.str();
+void Quasiquote::PrintTo(std::string& out, bool print_readably) {
+    out += "(quasiquote ";
+    child_.PrintTo(out, print_readably);
+    out += ')';
 }
 
 bool Quasiquote::operator==(MalType& other) {
@@ -257,14 +878,10 @@ bool Quasiquote::operator==(MalType& other) {
     return child_ == static_cast<Quasiquote*>(&other)->child_;
 }
 
-std::string Unquote::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
-
-    ss << "(unquote ";
-    ss << child_->Print(print_readably);
-    ss << ")";
-
-    return ss.str();
+void Unquote::PrintTo(std::string& out, bool print_readably) {
+    out += "(unquote ";
+    child_.PrintTo(out, print_readably);
+    out += ')';
 }
 
 bool Unquote::operator==(MalType& other) {
@@ -274,31 +891,258 @@ bool Unquote::operator==(MalType& other) {
     return child_ == static_cast<Unquote*>(&other)->child_;
 }
 
-std::string Nil::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+void Builtin::ThrowArity() const {
+    throw std::logic_error(std::string{name_} + ": wrong number of arguments!");
+}
+
+Closure::Closure(std::vector<InternId> binds, MalNode body, GcRef<Environment> env, std::shared_ptr<const Chunk> chunk) :
+    MalType{MalType::NodeType::Closure}, binds_{std::move(binds)}, body_{body}, env_{env}, chunk_{std::move(chunk)} {}
 
-    ss << "nil";
+Closure::~Closure() {}
 
-    return ss.str();
+void Closure::Trace(GcVisitor& visitor) {
+    TraceNode(visitor, body_);
+    if (env_)
+        visitor.Visit(env_.get());
+    for (auto& capture : captures_)
+        TraceNode(visitor, capture);
 }
 
-bool Nil::operator==(MalType& other)  {
-    return other.type_ == type_;
+void Closure::Clear() {
+    body_ = MalNode{};
+    env_.reset();
+    captures_.clear();
 }
 
-std::string Function::Print([[maybe_unused]] bool print_readably) {
-    std::stringstream ss;
+void Closure::PrintTo(std::string& out, [[maybe_unused]] bool print_readably) {
+    out += "function";
+}
 
-    ss << "function";
+namespace {
+    ClosureApply closure_apply = nullptr;
+}
 
-    return ss.str();
+void SetClosureApply(ClosureApply apply) {
+    closure_apply = apply;
 }
 
-MalNode Function::ApplyFn(std::vector<MalNode>& nodes) {
-    return func_(nodes);
+MalNode ApplyFunction(const MalNode& fn, std::vector<MalNode>& args) {
+    if (fn.Type() == MalType::NodeType::Builtin)
+        return fn.As<Builtin>()->Call(args);
+    if (fn.Type() != MalType::NodeType::Closure)
+        throw std::logic_error(fn.Print(true) + " is not a function!");
+    if (closure_apply == nullptr)
+        throw std::logic_error("no evaluator to call functions!");
+
+    return closure_apply(fn, args);
 }
 
-bool Function::operator==( [[maybe_unused]] MalType& other) {
+LazySeq::~LazySeq() {
+    // A long realized seq is a long chain of rest_, freed in a loop here rather than recursively
+    auto rest = std::move(rest_);
+    while (rest.Type() == NodeType::LazySeq && rest.Get()->refcount_ == 1) {
+        auto next = std::move(rest.As<LazySeq>()->rest_);
+        rest = std::move(next);
+    }
+}
+
+void LazySeq::PrintTo(std::string& out, bool print_readably) {
+    out += '(';
+    for (SeqCursor cursor {MalNode::Share(this)}; !cursor.Done(); ) {
+        cursor.Get().PrintTo(out, print_readably);
+
+        cursor.Next();
+        if (!cursor.Done())
+            out += ' ';
+    }
+    out += ')';
+}
+
+bool LazySeq::operator==(MalType& other) {
+    if (other.type_ != NodeType::List && other.type_ != NodeType::Vector && other.type_ != NodeType::LazySeq)
+        return false;
+
+    SeqCursor cursor {MalNode::Share(this)};
+    SeqCursor other_cursor {MalNode::Share(&other)};
+    for (; !cursor.Done(); cursor.Next(), other_cursor.Next()) {
+        if (other_cursor.Done() || !(cursor.Get() == other_cursor.Get()))
+            return false;
+    }
+
+    return other_cursor.Done();
+}
+
+std::size_t LazySeq::Hash() {
+    return SequenceHash([&](auto&& f) {
+        for (SeqCursor cursor {MalNode::Share(this)}; !cursor.Done(); cursor.Next())
+            f(cursor.Get());
+    });
+}
+
+void LazySeq::Trace(GcVisitor& visitor) {
+    TraceNode(visitor, fn_);
+    TraceNode(visitor, source_);
+    TraceNode(visitor, state_);
+    for (auto& element : chunk_)
+        TraceNode(visitor, element);
+    TraceNode(visitor, rest_);
+}
+
+void LazySeq::Clear() {
+    fn_ = MalNode{};
+    source_ = MalNode{};
+    state_ = MalNode{};
+    chunk_.clear();
+    rest_ = MalNode{};
+}
+
+SeqCursor::SeqCursor(MalNode seq, std::size_t offset) : seq_{std::move(seq)}, offset_{offset} {
+    if (!IsSeq(seq_))
+        throw std::logic_error(seq_.Print(true) + " is not a sequence!");
+}
+
+bool SeqCursor::Done() {
+    while (seq_.Type() == MalType::NodeType::LazySeq) {
+        auto lazy = seq_.As<LazySeq>();
+        lazy->Realize();
+        if (offset_ < lazy->chunk_.size())
+            return false;
+
+        offset_ -= lazy->chunk_.size();
+        auto rest = lazy->rest_;
+        seq_ = std::move(rest);
+    }
+
+    switch (seq_.Type()) {
+        case MalType::NodeType::List:
+            if (offset_ < seq_.As<List>()->children_.size())
+                return false;
+            break;
+        case MalType::NodeType::Vector:
+            if (offset_ < seq_.As<Vector>()->Size())
+                return false;
+            break;
+        default:
+            break;
+    }
+
+    seq_ = MalNode{};
+    offset_ = 0;
     return true;
 }
 
+const MalNode& SeqCursor::Get() const {
+    switch (seq_.Type()) {
+        case MalType::NodeType::List:
+            return seq_.As<List>()->children_[offset_];
+        case MalType::NodeType::Vector:
+            return seq_.As<Vector>()->Nth(offset_);
+        default:
+            return seq_.As<LazySeq>()->chunk_[offset_];
+    }
+}
+
+MalNode SeqCursor::Rest() const {
+    if (offset_ == 0)
+        return seq_;
+
+    return LazySeq::Drop(0, seq_, offset_);
+}
+
+void MalType::PrintTo(std::string& out, bool print_readably) {
+    Visit([&](auto& value) { value.PrintTo(out, print_readably); });
+}
+
+bool MalType::operator==(MalType& other) {
+    return Visit([&](auto& value) { return value.operator==(other); });
+}
+
+std::size_t MalType::Hash() {
+    return Visit([](auto& value) { return value.Hash(); });
+}
+
+std::string MalType::Print(bool print_readably) {
+    std::string out;
+    PrintTo(out, print_readably);
+
+    return out;
+}
+
+std::string MalNode::Print(bool print_readably) const {
+    std::string out;
+    PrintTo(out, print_readably);
+
+    return out;
+}
+
+void MalNode::PrintTo(std::string& out, bool print_readably) const {
+    char buffer[32];
+
+    switch (type_) {
+        case NodeType::Nil:
+            out += "nil";
+            break;
+        case NodeType::Boolean:
+            out += bool_ ? "true" : "false";
+            break;
+        case NodeType::Int:
+            out.append(buffer, std::to_chars(buffer, std::end(buffer), int_).ptr);
+            break;
+        case NodeType::Double:
+            // Same digits as streaming the double, the default 6 significant ones
+            out.append(buffer, std::to_chars(buffer, std::end(buffer), double_, std::chars_format::general, 6).ptr);
+            break;
+        case NodeType::Symbol:
+            out += InternTable::Instance().Name(id_);
+            break;
+        case NodeType::Keyword:
+            out += ':';
+            out += InternTable::Instance().Name(id_);
+            break;
+        default:
+            ptr_->PrintTo(out, print_readably);
+    }
+}
+
+std::size_t MalNode::Hash() const {
+    switch (type_) {
+        case NodeType::Nil:
+            return 0;
+        case NodeType::Boolean:
+            return bool_ ? 1231 : 1237;
+        case NodeType::Int:
+            return MixHash(static_cast<std::uint64_t>(int_));
+        case NodeType::Double:
+            // 0.0 and -0.0 compare equal
+            return MixHash(double_ == 0.0 ? 0 : std::bit_cast<std::uint64_t>(double_));
+        case NodeType::Symbol:
+        case NodeType::Keyword:
+            return MixHash((static_cast<std::uint64_t>(type_) << 32) | id_);
+        default:
+            return ptr_->Hash();
+    }
+}
+
+bool MalNode::operator==(const MalNode& other) const {
+    if (IsHeap() && other.IsHeap())
+        return ptr_ == other.ptr_ || *ptr_ == *other.ptr_;
+
+    if (type_ != other.type_)
+        return false;
+
+    switch (type_) {
+        case NodeType::Nil:
+            return true;
+        case NodeType::Boolean:
+            return bool_ == other.bool_;
+        case NodeType::Int:
+            return int_ == other.int_;
+        case NodeType::Double:
+            return double_ == other.double_;
+        case NodeType::Symbol:
+        case NodeType::Keyword:
+            return id_ == other.id_;
+        default:
+            return false;
+    }
+}
@@ -0,0 +1,413 @@
+#include "../include/vm.h"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__GNUC__)
+#define MAL_COMPUTED_GOTO 1
+#endif
+
+namespace {
+
+/*
+ * @brief Moves a closure's arguments, already on the stack at base, into its frame layout
+ *
+ * Fixed parameters stay in slots 0..arity-1 and the rest are packed into a list in slot
+ * arity.
+ * */
+void EnterClosure(Closure* func, MalNode* base, std::size_t argc, MalNode*& top, const MalNode* stack_end) {
+    const Chunk& chunk = *func->chunk_;
+
+    if (base + chunk.locals_ + chunk.max_stack_ >= stack_end)
+        throw std::logic_error("stack overflow!");
+
+    if (argc < chunk.arity_ || (!chunk.variadic_ && argc != chunk.arity_))
+        throw std::logic_error(chunk.name_ + ": wrong number of arguments!");
+
+    if (chunk.variadic_) {
+        auto rest = MalNode::Make<List>();
+        auto& children = rest.As<List>()->children_;
+        for (std::size_t index = chunk.arity_; index < argc; index++)
+            children.push_back(std::move(base[index]));
+
+        base[chunk.arity_] = std::move(rest);
+    }
+
+    // Slots past the arguments are above the old top, so already nil
+    top = base + chunk.locals_;
+}
+
+/*
+ * @brief Calls a builtin on the callee + args window ending at top, leaving the result in the callee slot
+ *
+ * Argument vectors are recycled between calls, so a builtin call does not allocate one.
+ * */
+MalNode* CallBuiltin(Builtin* builtin, MalNode* callee, MalNode* top) {
+    thread_local std::vector<std::vector<MalNode>> spare_args;
+
+    std::vector<MalNode> args;
+    if (!spare_args.empty()) {
+        args = std::move(spare_args.back());
+        spare_args.pop_back();
+    }
+
+    args.assign(std::make_move_iterator(callee + 1), std::make_move_iterator(top));
+    *callee = builtin->Call(args);
+
+    args.clear();
+    spare_args.push_back(std::move(args));
+
+    return callee + 1;
+}
+
+} // namespace
+
+VM& VM::Instance() {
+    thread_local VM vm;
+    return vm;
+}
+
+VM::VM() : stack_(stack_size), sp_{0}, frames_{}, globals_{nullptr}, globals_id_{0} {
+    frames_.reserve(1024);
+}
+
+MalNode VM::Run(std::shared_ptr<const Chunk> chunk, Environment& env) {
+    auto entry_depth = frames_.size();
+    auto entry_sp = sp_;
+    auto entry_globals = globals_;
+    auto entry_globals_id = globals_id_;
+
+    if (sp_ + 1 + chunk->locals_ + chunk->max_stack_ >= stack_size)
+        throw std::logic_error("stack overflow!");
+
+    globals_ = &env;
+    globals_id_ = env.Id();
+    sp_++; // callee slot, nil for a top-level form
+    frames_.push_back(Frame{chunk.get(), chunk->code_.data(), sp_, nullptr});
+    sp_ += chunk->locals_;
+
+    try {
+        auto result = Execute(entry_depth);
+        globals_ = entry_globals;
+        globals_id_ = entry_globals_id;
+
+        return result;
+    } catch (...) {
+        globals_ = entry_globals;
+        globals_id_ = entry_globals_id;
+        Unwind(entry_depth, entry_sp);
+        throw;
+    }
+}
+
+MalNode VM::Call(const MalNode& callee, std::vector<MalNode>& args) {
+    if (callee.Type() == MalType::NodeType::Builtin)
+        return callee.As<Builtin>()->Call(args);
+    if (callee.Type() != MalType::NodeType::Closure)
+        throw std::logic_error(callee.Print(true) + " is not a function!");
+
+    auto func = callee.As<Closure>();
+    if (!func->chunk_)
+        throw std::logic_error("function has no bytecode!");
+
+    if (sp_ + 1 + args.size() >= stack_size)
+        throw std::logic_error("stack overflow!");
+
+    auto entry_depth = frames_.size();
+    auto entry_sp = sp_;
+    auto entry_globals = globals_;
+    auto entry_globals_id = globals_id_;
+
+    // Closures keep the globals they were made under
+    auto globals = func->env_.get();
+
+    MalNode* stack = stack_.data();
+    MalNode* base = stack + sp_ + 1;
+    base[-1] = callee;
+    std::ranges::copy(args, base);
+    MalNode* top = base + args.size();
+    sp_ = static_cast<std::size_t>(top - stack);
+
+    globals_ = globals;
+    globals_id_ = globals->Id();
+
+    try {
+        EnterClosure(func, base, args.size(), top, stack + stack_size);
+        frames_.push_back(Frame{func->chunk_.get(), func->chunk_->code_.data(), static_cast<std::size_t>(base - stack), func->captures_.data()});
+        sp_ = static_cast<std::size_t>(top - stack);
+
+        auto result = Execute(entry_depth);
+        globals_ = entry_globals;
+        globals_id_ = entry_globals_id;
+
+        return result;
+    } catch (...) {
+        globals_ = entry_globals;
+        globals_id_ = entry_globals_id;
+        Unwind(entry_depth, entry_sp);
+        throw;
+    }
+}
+
+void VM::Unwind(std::size_t entry_depth, std::size_t entry_sp) {
+    for (auto index = entry_sp; index < sp_; index++)
+        stack_[index] = MalNode{};
+
+    sp_ = entry_sp;
+    frames_.erase(frames_.begin() + static_cast<std::ptrdiff_t>(entry_depth), frames_.end());
+}
+
+/*
+ * @brief The dispatch loop, returning once the frame at entry_depth returns
+ *
+ * top is kept in a register and written back to sp_ (SYNC) before anything that
+ * can throw, so Run can release the stack when unwinding. frame is fetched again
+ * after a builtin call, since a builtin can call back into the VM through Call
+ * (e.g. realizing a lazy map) and the frames it pushes can reallocate frames_.
+ * */
+MalNode VM::Execute(std::size_t entry_depth) {
+    MalNode* stack = stack_.data();
+    const MalNode* stack_end = stack + stack_size;
+    MalNode* top = stack + sp_;
+    Frame* frame = &frames_.back();
+    const std::uint8_t* ip = frame->ip_;
+
+#define READ_OPERAND() (ip += 2, static_cast<std::uint16_t>(ip[-2] | (ip[-1] << 8)))
+#define CONSTANT(index) (frame->chunk_->constants_[index])
+#define SYNC() (sp_ = static_cast<std::size_t>(top - stack))
+
+#ifdef MAL_COMPUTED_GOTO
+    static void* dispatch_table[] = {
+        &&op_Constant, &&op_Nil, &&op_True, &&op_False, &&op_Pop, &&op_LoadLocal, &&op_StoreLocal,
+        &&op_LoadBoxed, &&op_StoreBoxed, &&op_LoadCapture, &&op_LoadCaptureBoxed, &&op_LoadGlobal,
+        &&op_DefineGlobal, &&op_Jump, &&op_JumpIfFalse, &&op_Call, &&op_TailCall, &&op_Return, &&op_Closure, &&op_MakeVector,
+        &&op_MakeHashMap
+    };
+    static_assert(std::size(dispatch_table) == static_cast<std::size_t>(OpCode::Count));
+
+#define CASE(op) op_##op:
+#define DISPATCH() goto *dispatch_table[*ip++]
+
+    DISPATCH();
+#else
+#define CASE(op) case OpCode::op:
+#define DISPATCH() continue
+
+    while (true) {
+    switch (static_cast<OpCode>(*ip++)) {
+#endif
+
+    CASE(Constant) {
+        *top++ = CONSTANT(READ_OPERAND());
+        DISPATCH();
+    }
+    CASE(Nil) {
+        *top++ = MalNode::Nil();
+        DISPATCH();
+    }
+    CASE(True) {
+        *top++ = MalNode::Boolean(true);
+        DISPATCH();
+    }
+    CASE(False) {
+        *top++ = MalNode::Boolean(false);
+        DISPATCH();
+    }
+    CASE(Pop) {
+        *--top = MalNode{};
+        DISPATCH();
+    }
+    CASE(LoadLocal) {
+        *top++ = stack[frame->base_ + READ_OPERAND()];
+        DISPATCH();
+    }
+    CASE(StoreLocal) {
+        stack[frame->base_ + READ_OPERAND()] = std::move(*--top);
+        DISPATCH();
+    }
+    CASE(LoadBoxed) {
+        auto& slot = stack[frame->base_ + READ_OPERAND()];
+        *top++ = (slot.Type() == MalType::NodeType::Box) ? slot.As<Box>()->value_ : slot;
+        DISPATCH();
+    }
+    CASE(StoreBoxed) {
+        // The slot is only boxed once a closure captured it, which may not have run
+        auto& slot = stack[frame->base_ + READ_OPERAND()];
+        if (slot.Type() == MalType::NodeType::Box)
+            slot.As<Box>()->value_ = std::move(*--top);
+        else
+            slot = std::move(*--top);
+        DISPATCH();
+    }
+    CASE(LoadCapture) {
+        *top++ = frame->captures_[READ_OPERAND()];
+        DISPATCH();
+    }
+    CASE(LoadCaptureBoxed) {
+        *top++ = frame->captures_[READ_OPERAND()].As<Box>()->value_;
+        DISPATCH();
+    }
+    CASE(LoadGlobal) {
+        auto& site = frame->chunk_->globals_[READ_OPERAND()];
+        if (site.env_id_ != globals_id_) {
+            SYNC();
+            site.cell_ = globals_->Find(site.symbol_);
+            if (site.cell_ == nullptr)
+                throw std::logic_error(InternTable::Instance().Name(site.symbol_) + " not found!");
+            site.env_id_ = globals_id_;
+        }
+
+        *top++ = *site.cell_;
+        DISPATCH();
+    }
+    CASE(DefineGlobal) {
+        SYNC();
+        globals_->Set(frame->chunk_->globals_[READ_OPERAND()].symbol_, top[-1]);
+        DISPATCH();
+    }
+    CASE(Jump) {
+        auto offset = READ_OPERAND();
+        ip += offset;
+        DISPATCH();
+    }
+    CASE(JumpIfFalse) {
+        auto offset = READ_OPERAND();
+        if (!(--top)->IsTruthy())
+            ip += offset;
+        *top = MalNode{};
+        DISPATCH();
+    }
+    CASE(Call) {
+        auto argc = READ_OPERAND();
+        MalNode* callee = top - argc - 1;
+        SYNC();
+
+        if (callee->Type() == MalType::NodeType::Builtin) {
+            top = CallBuiltin(callee->As<Builtin>(), callee, top);
+            frame = &frames_.back();
+            DISPATCH();
+        }
+        if (callee->Type() != MalType::NodeType::Closure)
+            throw std::logic_error(callee->Print(true) + " is not a function!");
+
+        auto func = callee->As<Closure>();
+        frame->ip_ = ip;
+        EnterClosure(func, callee + 1, argc, top, stack_end);
+        frames_.push_back(Frame{func->chunk_.get(), func->chunk_->code_.data(), static_cast<std::size_t>(callee + 1 - stack), func->captures_.data()});
+
+        frame = &frames_.back();
+        ip = frame->ip_;
+        DISPATCH();
+    }
+    CASE(TailCall) {
+        auto argc = READ_OPERAND();
+        MalNode* callee = top - argc - 1;
+        SYNC();
+
+        // A builtin returns at once, the Return that follows finishes the frame
+        if (callee->Type() == MalType::NodeType::Builtin) {
+            top = CallBuiltin(callee->As<Builtin>(), callee, top);
+            frame = &frames_.back();
+            DISPATCH();
+        }
+        if (callee->Type() != MalType::NodeType::Closure)
+            throw std::logic_error(callee->Print(true) + " is not a function!");
+
+        auto func = callee->As<Closure>();
+
+        // Slide the callee and arguments down over the current frame, which releases it
+        MalNode* dest = stack + frame->base_ - 1;
+        for (std::size_t index = 0; index <= argc; index++)
+            dest[index] = std::move(callee[index]);
+        for (MalNode* slot = dest + argc + 1; slot < top; slot++)
+            *slot = MalNode{};
+        top = dest + argc + 1;
+
+        EnterClosure(func, dest + 1, argc, top, stack_end);
+        frame->chunk_ = func->chunk_.get();
+        frame->captures_ = func->captures_.data();
+        ip = frame->chunk_->code_.data();
+        DISPATCH();
+    }
+    CASE(Return) {
+        auto result = std::move(*--top);
+
+        for (MalNode* slot = stack + frame->base_ - 1; slot < top; slot++)
+            *slot = MalNode{};
+        top = stack + frame->base_ - 1;
+        frames_.pop_back();
+
+        if (frames_.size() == entry_depth) {
+            SYNC();
+            return result;
+        }
+
+        *top++ = std::move(result);
+        frame = &frames_.back();
+        ip = frame->ip_;
+        DISPATCH();
+    }
+    CASE(Closure) {
+        SYNC();
+        auto& function = frame->chunk_->functions_[READ_OPERAND()];
+        auto closure_node = MalNode::Make<Closure>(function->binds_, function->body_, GcRef<Environment>{globals_}, function);
+
+        auto& captures = closure_node.As<Closure>()->captures_;
+        captures.reserve(function->captures_.size());
+        for (auto& capture : function->captures_) {
+            if (!capture.local_) {
+                captures.push_back(frame->captures_[capture.index_]);
+                continue;
+            }
+
+            // The first closure to capture a boxed variable moves it into the box
+            auto& slot = stack[frame->base_ + capture.index_];
+            if (capture.boxed_ && slot.Type() != MalType::NodeType::Box)
+                slot = MalNode::Make<Box>(std::move(slot));
+            captures.push_back(slot);
+        }
+
+        *top++ = std::move(closure_node);
+        DISPATCH();
+    }
+    CASE(MakeVector) {
+        auto count = READ_OPERAND();
+        SYNC();
+
+        auto vector_node = MalNode::Make<Vector>();
+        auto vector = vector_node.As<Vector>();
+        for (MalNode* element = top - count; element < top; element++)
+            vector->Add(std::move(*element));
+
+        top -= count;
+        *top++ = std::move(vector_node);
+        DISPATCH();
+    }
+    CASE(MakeHashMap) {
+        auto count = READ_OPERAND();
+        SYNC();
+
+        auto hash_map_node = MalNode::Make<HashMap>();
+        auto hash_map = hash_map_node.As<HashMap>();
+        for (MalNode* entry = top - 2 * count; entry < top; entry += 2)
+            hash_map->Add(std::move(entry[0]), std::move(entry[1]));
+
+        top -= 2 * count;
+        *top++ = std::move(hash_map_node);
+        DISPATCH();
+    }
+
+#ifndef MAL_COMPUTED_GOTO
+    default:
+        throw std::logic_error("bad opcode!");
+    }
+    }
+#endif
+
+#undef READ_OPERAND
+#undef CONSTANT
+#undef SYNC
+#undef CASE
+#undef DISPATCH
+}